@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform samplerBuffer instanceTransforms;
+uniform int instanceOffset;
+
+// must match geometry.vert bit for bit, or the GL_EQUAL depth test of the G-buffer pass rejects pixels
+invariant gl_Position;
+
+mat4 getInstanceTransform()
+{
+    int base = (instanceOffset + gl_InstanceID) * 4;
+    return mat4(texelFetch(instanceTransforms, base), texelFetch(instanceTransforms, base + 1),
+                texelFetch(instanceTransforms, base + 2), texelFetch(instanceTransforms, base + 3));
+}
+
+void main()
+{
+    mat4 instanceModel = model * getInstanceTransform();
+    vec4 worldPos = instanceModel * vec4(aPos, 1.0);
+    gl_Position = projection * view * worldPos;
+}
@@ -1,8 +1,8 @@
 #version 330 core
 
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec4 gAlbedoSpec;
+layout (location = 0) out vec3 gNormal;     // compact: octahedral-encoded in .xy; wide: view-space normal
+layout (location = 1) out vec4 gAlbedoSpec;
+layout (location = 2) out vec3 gPosition;   // wide layout only; compact rebuilds it from the depth buffer
 
 in VS_OUT {
     vec3 FragPos;   // world-space position
@@ -19,19 +19,34 @@ uniform sampler2D occlusionTexture; // unused in G-buffer (optional)
 uniform sampler2D emissiveTexture;  // unused in G-buffer (optional)
 
 uniform float specularStrength = 0.5;
+uniform bool compactGBuffer = true; // see DeferredRenderer::setCompactGBuffer
 
-void main()
+// Octahedral mapping of a unit vector onto [0,1]^2 (see decodeNormal in lighting.frag)
+vec2 encodeNormal(vec3 n)
 {
-    // Position in view space
-    vec3 viewPos = vec3(view * vec4(fs_in.FragPos, 1.0));
-    gPosition = viewPos;
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    vec2 folded = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+    return folded * 0.5 + 0.5;
+}
 
+void main()
+{
     // Normal mapping (tangent → view space)
-    vec3 texNormal = texture(normalTexture, fs_in.TexCoord).rgb;
-    texNormal = normalize(texNormal * 2.0 - 1.0);   // [0,1] → [-1,1]
+    vec4 normalSample = texture(normalTexture, fs_in.TexCoord);
+    vec3 texNormal = normalSample.rgb * 2.0 - 1.0;  // [0,1] → [-1,1]
+    // BC5 normal maps hold x and y only and come with alpha swizzled to 0; z is the rest of the unit length
+    if (normalSample.a == 0.0)
+        texNormal.z = sqrt(max(0.0, 1.0 - dot(texNormal.xy, texNormal.xy)));
+    texNormal = normalize(texNormal);
     vec3 worldNormal = normalize(fs_in.TBN * texNormal);
     vec3 viewNormal  = normalize(mat3(view) * worldNormal);
-    gNormal = viewNormal;
+    if (compactGBuffer) {
+        gNormal = vec3(encodeNormal(viewNormal), 0.0);
+    } else {
+        gNormal = viewNormal;
+        gPosition = vec3(view * vec4(fs_in.FragPos, 1.0));
+    }
 
     // Albedo
     vec3 albedo = texture(diffuseTexture, fs_in.TexCoord).rgb;
@@ -10,25 +10,40 @@ out VS_OUT {
     mat3 TBN;       // tangent-bitangent-normal matrix
 } vs_out;
 
-uniform mat4 model;
+uniform mat4 model;                      // scene normalization, shared by every instance
 uniform mat4 view;
 uniform mat4 projection;
+uniform samplerBuffer instanceTransforms; // node transform per instance, four RGBA32F columns
+uniform int instanceOffset;               // first instance of this draw (no base instance in 3.3)
+
+// shared with depth.vert so the depth pre-pass and this pass produce identical depths
+invariant gl_Position;
+
+mat4 getInstanceTransform()
+{
+    int base = (instanceOffset + gl_InstanceID) * 4;
+    return mat4(texelFetch(instanceTransforms, base), texelFetch(instanceTransforms, base + 1),
+                texelFetch(instanceTransforms, base + 2), texelFetch(instanceTransforms, base + 3));
+}
 
 void main()
 {
+    mat4 instanceModel = model * getInstanceTransform();
+
     // World position
-    vec4 worldPos = model * vec4(aPos, 1.0);
+    vec4 worldPos = instanceModel * vec4(aPos, 1.0);
     vs_out.FragPos = worldPos.xyz;
 
     // Normal & tangent → world space
-    vec3 N = normalize(mat3(transpose(inverse(model))) * aNormal);
-    vec3 T = normalize(mat3(model) * aTangent.xyz);
+    vec3 N = normalize(mat3(transpose(inverse(instanceModel))) * aNormal);
+    vec3 T = normalize(mat3(instanceModel) * aTangent.xyz);
 
     // Gram-Schmidt orthogonalization to avoid skewed T
     T = normalize(T - dot(T, N) * N);
 
     // Bitangent reconstructed with handedness
-    vec3 B = cross(N, T) * aTangent.w;
+    // only the sign of w is meaningful: GL 3.3 decodes a packed 2-bit -1 as -1/3
+    vec3 B = cross(N, T) * (aTangent.w < 0.0 ? -1.0 : 1.0);
 
     vs_out.TBN = mat3(T, B, N);
 
@@ -2,28 +2,54 @@
 in vec2 TexCoords;
 out vec4 FragColor;
 
-uniform sampler2D  gPosition;      // view-space position
-uniform sampler2D  gNormal;        // view-space normal
+uniform sampler2D  gDepth;         // window-space depth, unprojected back to view space
+uniform sampler2D  gNormal;        // octahedral-encoded (compact) or raw view-space normal
+uniform sampler2D  gPosition;      // view-space position, wide layout only
 uniform sampler2D  gAlbedoSpec;    // albedo.rgb (sRGB?) + gloss in .a
-uniform isampler2D clusterLightTex;
-
-struct Light {
-    vec4 position_radius; // xyz world-space, w radius
-    vec3 color;           // 0..1 radiance scale
-    float intensity;
+uniform usampler2D clusterGrid;        // (offset, count) per cluster, one row per Z slice
+uniform usamplerBuffer clusterLightList; // light indices of every cluster, packed
+
+// two texels per light: (xyz world-space position, radius), (rgb 0..1 radiance scale, intensity)
+uniform samplerBuffer lightData;
+
+uniform bool compactGBuffer = true; // see DeferredRenderer::setCompactGBuffer
+
+// per-frame constants, uploaded in one go (DeferredRenderer::LightingParams)
+layout (std140) uniform LightingParams {
+    mat4 view;
+    mat4 inverseProjection;
+    int screenWidth, screenHeight;
+    int CLUSTER_X, CLUSTER_Y, CLUSTER_Z;
+    int numLights;
+    float nearPlane, farPlane;
 };
-uniform Light lights[256];
-uniform int   numLights;
 
-uniform int screenWidth, screenHeight;
-uniform int CLUSTER_X, CLUSTER_Y, CLUSTER_Z, MAX_LIGHTS_PER_CLUSTER;
-uniform float nearPlane, farPlane;
-uniform mat4 view;
+vec3 decodeNormal(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy -= vec2(n.x >= 0.0 ? t : -t, n.y >= 0.0 ? t : -t);
+    return normalize(n);
+}
 
 void main() {
     // G-buffer fetch
-    vec3 fragPosVS = texture(gPosition, TexCoords).rgb;
-    vec3 N = normalize(texture(gNormal, TexCoords).rgb);
+    float depth = texture(gDepth, TexCoords).r;
+    if (depth >= 1.0) {
+        FragColor = vec4(0.0, 0.0, 0.0, 1.0); // nothing was drawn here
+        return;
+    }
+    vec3 fragPosVS;
+    vec3 N;
+    if (compactGBuffer) {
+        vec4 clipPos = vec4(vec3(TexCoords, depth) * 2.0 - 1.0, 1.0);
+        vec4 viewPos = inverseProjection * clipPos;
+        fragPosVS = viewPos.xyz / viewPos.w;
+        N = decodeNormal(texture(gNormal, TexCoords).rg);
+    } else {
+        fragPosVS = texture(gPosition, TexCoords).rgb;
+        N = normalize(texture(gNormal, TexCoords).rgb);
+    }
 
     vec4 albSpec = texture(gAlbedoSpec, TexCoords);
     // Albedo is already in linear space (loaded as sRGB)
@@ -42,18 +68,19 @@ void main() {
     float lnRatio = log(zVSpos / nearPlane) / log(farPlane / nearPlane);
     int cz = int(clamp(lnRatio * float(CLUSTER_Z), 0.0, float(CLUSTER_Z - 1)));
 
-    int clusterIdx = cx + cy * CLUSTER_X + cz * (CLUSTER_X * CLUSTER_Y);
+    uvec2 cluster = texelFetch(clusterGrid, ivec2(cx + cy * CLUSTER_X, cz), 0).rg;
 
     vec3 V = normalize(-fragPosVS);
     vec3 lighting = albedo * 0.1; // Add ambient lighting
 
-    for (int i = 0; i < MAX_LIGHTS_PER_CLUSTER; ++i) {
-        int li = texelFetch(clusterLightTex, ivec2(i, clusterIdx), 0).r;
-        if (li < 0 || li >= numLights) break;
+    for (uint i = 0u; i < cluster.y; ++i) {
+        int li = int(texelFetch(clusterLightList, int(cluster.x + i)).r);
+        if (li >= numLights) break;
 
-        Light L = lights[li];
-        vec3 LposWS = L.position_radius.xyz;
-        float radius = max(L.position_radius.w, 1e-3);
+        vec4 position_radius = texelFetch(lightData, li * 2);
+        vec4 color_intensity = texelFetch(lightData, li * 2 + 1);
+        vec3 LposWS = position_radius.xyz;
+        float radius = max(position_radius.w, 1e-3);
         
         // Transform light position to view space
         vec3 Lpos = (view * vec4(LposWS, 1.0)).xyz;
@@ -74,7 +101,7 @@ void main() {
         vec3 diffuse  = albedo * diff;
         vec3 specular = vec3(spec); // Pure specular highlight
 
-        lighting += L.color * L.intensity * att * (diffuse + specular);
+        lighting += color_intensity.rgb * color_intensity.a * att * (diffuse + specular);
     }
 
     // Optional: encode back to sRGB if default framebuffer is sRGB-disabled
@@ -7,30 +7,48 @@
 #include <GLFW/glfw3.h>
 #include "Application.h"
 #include "WindowCallbacks.h"
+#include "Profiler.h"
 #include <iostream>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
 
 const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
+const int TRACE_FRAMES = 120;
+// GL thread time a background model load may spend on uploads per frame
+const double LOAD_UPLOAD_BUDGET_MS = 4.0;
 
-void Application::run() {
-    initWindow();
+void Application::run(bool profileCpu) {
+    Profiler::setThreadName("main");
+    Profiler::setEnabled(profileCpu);
+    initWindow(SCR_WIDTH, SCR_HEIGHT);
     initGL();
+    initImGui();
     initCallbacks();
 
     scene = new Scene();
-    scene->loadModel(modelPathBuffer);
+    scene->loadModel(modelPathBuffer, loadOptions);
     lastLoadedModel = modelPathBuffer;
     renderer = new DeferredRenderer(SCR_WIDTH, SCR_HEIGHT, camera);
     cameraController = new CameraController(camera);
 
     while (!glfwWindowShouldClose(window)) {
+        Profiler::markFrame();
+        PROFILE_ZONE("frame");
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         processInput();
+        Shader::uniformCallCount = 0;
+        renderer->getPassTimer().beginFrame();
+        collectPassTimings();
 
-        glfwPollEvents();
+        {
+            PROFILE_ZONE("glfwPollEvents");
+            glfwPollEvents();
+        }
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -48,6 +66,10 @@ void Application::run() {
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        if (scene->updateLoading(LOAD_UPLOAD_BUDGET_MS)) {
+            lastLoadedModel = pendingModelPath;
+        }
+
         float currentTime = glfwGetTime();
         scene->updateLights(currentTime);
 
@@ -56,12 +78,30 @@ void Application::run() {
 
         ImGui::Begin("Debug Panel");
         ImGui::Text("FPS: %.1f", 1.0f / deltaTime);
+        ImGui::Text("Uniform calls/frame: %u", Shader::uniformCallCount);
+        const DrawStats& drawStats = renderer->getDrawStats();
+        ImGui::Text("Draw calls/frame: %u, state changes: %u", drawStats.drawCalls, drawStats.stateChanges);
+        drawTimingStats();
         ImGui::Separator();
         ImGui::InputText("Model Path", modelPathBuffer, IM_ARRAYSIZE(modelPathBuffer));
-        if (ImGui::Button("Load glTF")) {
-            scene->loadModel(modelPathBuffer);
-            lastLoadedModel = modelPathBuffer;
+        if (scene->isLoading()) {
+            // the current model keeps rendering until the new one is fully uploaded
+            ModelLoadProgress progress = scene->getLoadProgress();
+            ImGui::Text("Loading %s", pendingModelPath.c_str());
+            ImGui::ProgressBar(progress.fraction, ImVec2(-1, 0), getModelLoadStageName(progress.stage));
+        } else if (ImGui::Button("Load glTF")) {
+            scene->beginLoadModel(modelPathBuffer, loadOptions);
+            pendingModelPath = modelPathBuffer;
+        }
+        ImGui::Checkbox("Quantize vertices", &loadOptions.quantizeVertices);
+        ImGui::Checkbox("Optimize vertex cache", &loadOptions.optimizeMeshes);
+        if (loadOptions.optimizeMeshes) {
+            ImGui::SameLine();
+            ImGui::Checkbox("Overdraw order", &loadOptions.reduceOverdraw);
         }
+        ImGui::Checkbox("Use mesh cache", &loadOptions.useMeshCache);
+        ImGui::Checkbox("Use texture cache", &loadOptions.useTextureCache);
+        ImGui::Checkbox("Compress textures", &loadOptions.compressTextures);
         ImGui::TextWrapped("Current model: %s", lastLoadedModel.c_str());
         ImGui::Separator();
         ImGui::Text("Add Light");
@@ -72,6 +112,10 @@ void Application::run() {
         if (ImGui::Button("Add Light")) {
             scene->addLight(newLightPos, newLightRadius, newLightColor, newLightIntensity);
         }
+        ImGui::SameLine();
+        if (ImGui::Button("Add 1000 Lights")) {
+            scene->addRandomLights(1000);
+        }
         ImGui::Text("Total lights: %zu", scene->getLights().size());
         ImGui::Separator();
         ImGui::Text("Animate Lights");
@@ -79,11 +123,44 @@ void Application::run() {
         if (ImGui::Button(animatedLights ? "ON" : "OFF")) {
             scene->setAnimate(!animatedLights);
         }
+        ImGui::Separator();
+        int assignThreads = renderer->getAssignmentThreadCount();
+        int maxAssignThreads = std::max(1u, std::thread::hardware_concurrency());
+        if (ImGui::SliderInt("Assign Threads", &assignThreads, 1, maxAssignThreads)) {
+            renderer->setAssignmentThreadCount(assignThreads);
+        }
+        ImGui::Text("Culling kernel: %s", renderer->getCullingKernelName());
+        bool frustumCulling = renderer->isFrustumCullingEnabled();
+        if (ImGui::Checkbox("Frustum culling", &frustumCulling)) {
+            renderer->setFrustumCulling(frustumCulling);
+        }
+        ImGui::Text("Instances drawn: %d, culled: %d", renderer->getInstancesDrawn(), renderer->getInstancesCulled());
+        bool depthPrepass = renderer->isDepthPrepassEnabled();
+        if (ImGui::Checkbox("Depth pre-pass", &depthPrepass)) {
+            renderer->setDepthPrepass(depthPrepass);
+        }
+        bool compactGBuffer = renderer->isCompactGBufferEnabled();
+        if (ImGui::Checkbox("Compact G-buffer", &compactGBuffer)) {
+            renderer->setCompactGBuffer(compactGBuffer);
+        }
+        ImGui::Separator();
+        bool profiling = Profiler::isEnabled();
+        if (ImGui::Checkbox("CPU profiler", &profiling)) {
+            Profiler::setEnabled(profiling);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Dump trace (F9)")) {
+            Profiler::writeChromeTrace("trace.json", TRACE_FRAMES);
+        }
         ImGui::End();
 
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            PROFILE_ZONE("imgui");
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
 
+        PROFILE_ZONE("glfwSwapBuffers");
         glfwSwapBuffers(window);
     }
 
@@ -91,7 +168,125 @@ void Application::run() {
     glfwTerminate();
 }
 
-void Application::initWindow() {
+int Application::runBenchmark(const BenchmarkOptions& options) {
+    Profiler::setThreadName("main");
+    Profiler::setEnabled(!options.tracePath.empty());
+    initWindow(options.width, options.height, true);
+    initGL();
+    glfwSwapInterval(0); // never let vsync cap the measured frame rate
+
+    scene = new Scene();
+    ModelLoadOptions benchmarkLoadOptions;
+    benchmarkLoadOptions.quantizeVertices = options.quantizeVertices;
+    benchmarkLoadOptions.optimizeMeshes = options.optimizeMeshes;
+    benchmarkLoadOptions.reduceOverdraw = options.reduceOverdraw;
+    benchmarkLoadOptions.useMeshCache = options.meshCache;
+    benchmarkLoadOptions.useTextureCache = options.textureCache;
+    benchmarkLoadOptions.compressTextures = options.compressTextures;
+    scene->loadModel(options.modelPath, benchmarkLoadOptions);
+    if (options.extraLights > 0) {
+        scene->addRandomLights(options.extraLights);
+    }
+    renderer = new DeferredRenderer(options.width, options.height, camera);
+    renderer->setDepthPrepass(options.depthPrepass);
+    renderer->setCompactGBuffer(options.compactGBuffer);
+
+    BenchmarkResults results;
+    results.glRenderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    results.glVersion = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    results.lightCount = scene->getLights().size();
+
+    PassTimer& timer = renderer->getPassTimer();
+    for (int frame = 0; frame < options.frames; ++frame) {
+        Profiler::markFrame();
+        PROFILE_ZONE("frame");
+        auto frameStart = std::chrono::steady_clock::now();
+
+        camera.LookAt(getBenchmarkCameraPosition(frame, options.frames), glm::vec3(0.0f));
+        timer.beginFrame();
+
+        glViewport(0, 0, options.width, options.height);
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // fixed time step so every run animates the lights identically
+        scene->updateLights(static_cast<float>(frame) / 60.0f);
+
+        renderer->geometryPass(*scene, camera);
+        renderer->lightingPass(*scene, camera);
+
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+
+        results.frameCpuMs.push_back(std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - frameStart).count());
+        for (const FrameTiming& timing : timer.takeCompletedFrames()) {
+            results.passTimings.push_back(timing);
+        }
+    }
+
+    timer.flush();
+    for (const FrameTiming& timing : timer.takeCompletedFrames()) {
+        results.passTimings.push_back(timing);
+    }
+
+    bool written = writeBenchmarkReport(options, results);
+    if (!options.tracePath.empty()) {
+        written = Profiler::writeChromeTrace(options.tracePath, options.traceFrames) && written;
+    }
+
+    delete renderer;
+    delete scene;
+    glfwTerminate();
+    return written ? 0 : 1;
+}
+
+void Application::collectPassTimings() {
+    for (const FrameTiming& timing : renderer->getPassTimer().takeCompletedFrames()) {
+        timingHistory.add(timing);
+    }
+}
+
+void Application::drawTimingStats() {
+    ImGui::Text("Pass timings, last %zu frames (ms)", timingHistory.size());
+    if (ImGui::BeginTable("PassTimings", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Pass");
+        ImGui::TableSetupColumn("GPU min");
+        ImGui::TableSetupColumn("GPU avg");
+        ImGui::TableSetupColumn("GPU p95");
+        ImGui::TableSetupColumn("GPU p99");
+        ImGui::TableSetupColumn("CPU avg");
+        ImGui::TableHeadersRow();
+        for (int pass = 0; pass < RENDER_PASS_COUNT; ++pass) {
+            TimingSummary gpu = timingHistory.summarizeGpu(static_cast<RenderPass>(pass));
+            TimingSummary cpu = timingHistory.summarizeCpu(static_cast<RenderPass>(pass));
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::Text("%s", getRenderPassName(static_cast<RenderPass>(pass)));
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", gpu.min);
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", gpu.avg);
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", gpu.p95);
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", gpu.p99);
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", cpu.avg);
+        }
+        ImGui::EndTable();
+    }
+    if (ImGui::Button("Export CSV")) {
+        if (timingHistory.writeCsv("pass_timings.csv")) {
+            std::cout << "Pass timings written to pass_timings.csv\n";
+        }
+    }
+}
+
+void Application::initWindow(int width, int height, bool headless) {
+    bool offscreenContext = false;
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+    // With no display server at all, GLFW's null platform plus an OSMesa (e.g. llvmpipe) context
+    // renders entirely in memory. With a display, a hidden window is enough.
+    if (headless && !std::getenv("DISPLAY") && !std::getenv("WAYLAND_DISPLAY")) {
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+        offscreenContext = true;
+    }
+#endif
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -99,7 +294,13 @@ void Application::initWindow() {
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
-    window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "ClusteredDeferredRenderer", NULL, NULL);
+    if (headless) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+    if (offscreenContext) {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    }
+    window = glfwCreateWindow(width, height, "ClusteredDeferredRenderer", NULL, NULL);
     if (!window) {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -116,7 +317,6 @@ void Application::initGL() {
     }
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_FRAMEBUFFER_SRGB);
-    initImGui();
 }
 
 void Application::initCallbacks() {
@@ -127,6 +327,7 @@ void Application::initCallbacks() {
 }
 
 void Application::processInput() {
+    PROFILE_ZONE("processInput");
     cameraController->processKeyboard(window, deltaTime);
     int escapeState = glfwGetKey(window, GLFW_KEY_ESCAPE);
     if (escapeState == GLFW_PRESS && !escapePressedLastFrame) {
@@ -135,6 +336,12 @@ void Application::processInput() {
         cameraController->resetMouse();
     }
     escapePressedLastFrame = (escapeState == GLFW_PRESS);
+
+    int traceKeyState = glfwGetKey(window, GLFW_KEY_F9);
+    if (traceKeyState == GLFW_PRESS && !traceKeyPressedLastFrame) {
+        Profiler::writeChromeTrace("trace.json", TRACE_FRAMES);
+    }
+    traceKeyPressedLastFrame = (traceKeyState == GLFW_PRESS);
 }
 
 void Application::initImGui() {
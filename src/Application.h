@@ -12,6 +12,8 @@
 #include "CameraController.h"
 #include "camera.h"
 #include "DeferredRenderer.h"
+#include "Benchmark.h"
+#include "TimingStats.h"
 #include "imgui.h"
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_opengl3.h"
@@ -22,15 +24,20 @@ class GLFWwindow;
 
 class Application {
 public:
-    void run();
+    // profileCpu starts the zone profiler enabled (--profile); F9 dumps the last frames to trace.json
+    void run(bool profileCpu = false);
+    // renders a scripted camera path offscreen and writes a timing report; returns the exit code
+    int runBenchmark(const BenchmarkOptions& options);
     CameraController* cameraController = nullptr;
     bool isCursorCaptured() const { return cursorCaptured; }
 
 private:
-    void initWindow();
+    void initWindow(int width, int height, bool headless = false);
     void initGL();
     void initCallbacks();
     void processInput();
+    void collectPassTimings();
+    void drawTimingStats();
     void initImGui();
     void shutdownImGui();
 
@@ -39,14 +46,18 @@ private:
     Scene* scene = nullptr;
     DeferredRenderer* renderer = nullptr;
     Camera camera{glm::vec3(0.0f, 0.0f, 2.0f)};
+    TimingHistory timingHistory;
 
 
     float deltaTime = 0.0f;
     float lastFrame = 0.0f;
     bool cursorCaptured = true;
     bool escapePressedLastFrame = false;
+    bool traceKeyPressedLastFrame = false;
     char modelPathBuffer[256] = "assets/models/backpack/scene.gltf";
     std::string lastLoadedModel = modelPathBuffer;
+    std::string pendingModelPath;
+    ModelLoadOptions loadOptions;
     glm::vec3 newLightPos = glm::vec3(0.0f, 2.0f, 0.0f);
     float newLightRadius = 10.0f;
     glm::vec3 newLightColor = glm::vec3(1.0f, 0.9f, 0.7f);
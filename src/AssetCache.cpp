@@ -0,0 +1,491 @@
+#include "AssetCache.h"
+#include "ModelLoader.h"
+#include "TextureBaker.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    buffer.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(buffer.data()), buffer.size())) return false;
+    data = buffer.data();
+    size = buffer.size();
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (mapping == MAP_FAILED) return false;
+    data = static_cast<const uint8_t*>(mapping);
+    size = size_t(info.st_size);
+    return true;
+#endif
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    buffer = {};
+#else
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+uint64_t hashBytes(std::span<const uint8_t> bytes, uint64_t seed) {
+    uint64_t hash = seed;
+    for (uint8_t byte : bytes) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+FileStamp getFileStamp(const std::string& path) {
+    std::error_code error;
+    FileStamp stamp;
+    uintmax_t size = std::filesystem::file_size(path, error);
+    if (error) return {};
+    auto mtime = std::filesystem::last_write_time(path, error);
+    if (error) return {};
+    stamp.size = size;
+    stamp.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    return stamp;
+}
+
+namespace {
+
+constexpr char MESH_CACHE_MAGIC[8] = "CDRMESH";
+// bump whenever the layout below or the meaning of the packed data changes
+constexpr uint32_t MESH_CACHE_VERSION = 1;
+// large blobs start on this boundary so the mapped data stays aligned for the GPU copy
+constexpr size_t BLOB_ALIGNMENT = 16;
+
+// laid out without padding, so the bytes on disk are fully determined
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t options;
+    FileStamp source;
+    uint64_t sourceHash;
+    uint32_t bufferCount;
+    uint32_t meshCount;
+    uint32_t instanceCount;
+    uint32_t textureCount;
+    uint64_t vertexBytes;
+    uint64_t indexBytes;
+    float minBounds[3];
+    float maxBounds[3];
+};
+static_assert(sizeof(MeshCacheHeader) == 96, "MeshCacheHeader must not contain padding");
+
+constexpr char TEXTURE_CACHE_MAGIC[8] = "CDRTEX";
+constexpr uint32_t TEXTURE_CACHE_VERSION = 1;
+
+struct TextureCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    FileStamp source;
+    uint64_t sourceHash;
+    uint32_t levelCount;
+    uint32_t reserved;
+};
+static_assert(sizeof(TextureCacheHeader) == 48, "TextureCacheHeader must not contain padding");
+
+struct CachedTextureLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t bytes;
+};
+
+struct CachedMesh {
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    uint32_t indexType;
+    int32_t baseVertex;
+    uint32_t vertexCount;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+    int32_t textureSlots[5];
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+// hashes the source itself; external buffers are only checked by size and mtime
+bool hashSource(const std::string& path, uint64_t& hash) {
+    MappedFile source;
+    if (!source.open(path)) return false;
+    hash = hashBytes(source.bytes());
+    return true;
+}
+
+std::string relativeToSource(const std::string& path, const std::string& sourcePath) {
+    std::filesystem::path directory = std::filesystem::path(sourcePath).parent_path();
+    return std::filesystem::path(path).lexically_relative(directory).generic_string();
+}
+
+std::string resolveFromSource(const std::string& relative, const std::string& sourcePath) {
+    return (std::filesystem::path(sourcePath).parent_path() / relative).string();
+}
+
+class CacheWriter {
+public:
+    explicit CacheWriter(const std::string& path) : out(path, std::ios::binary | std::ios::trunc) {}
+
+    bool ok() const { return bool(out); }
+
+    void write(const void* bytes, size_t count) {
+        out.write(static_cast<const char*>(bytes), std::streamsize(count));
+        offset += count;
+    }
+    template <typename T> void write(const T& value) { write(&value, sizeof(T)); }
+    void writeString(const std::string& text) {
+        write(static_cast<uint32_t>(text.size()));
+        write(text.data(), text.size());
+    }
+    void align() {
+        static const char zeros[BLOB_ALIGNMENT] = {};
+        write(zeros, (BLOB_ALIGNMENT - offset % BLOB_ALIGNMENT) % BLOB_ALIGNMENT);
+    }
+
+private:
+    std::ofstream out;
+    size_t offset = 0;
+};
+
+// bounds-checked cursor over the mapped cache; every read fails once the file runs short
+class CacheReader {
+public:
+    explicit CacheReader(std::span<const uint8_t> bytes) : bytes(bytes) {}
+
+    bool read(void* out, size_t count) {
+        if (count > bytes.size() - offset) return false;
+        std::memcpy(out, bytes.data() + offset, count);
+        offset += count;
+        return true;
+    }
+    template <typename T> bool read(T& value) { return read(&value, sizeof(T)); }
+    bool readString(std::string& text) {
+        uint32_t length;
+        if (!read(length) || length > bytes.size() - offset) return false;
+        text.assign(reinterpret_cast<const char*>(bytes.data() + offset), length);
+        offset += length;
+        return true;
+    }
+    bool view(size_t count, std::span<const uint8_t>& out) {
+        if (count > bytes.size() - offset) return false;
+        out = bytes.subspan(offset, count);
+        offset += count;
+        return true;
+    }
+    // for sizing containers from counts in the file before trusting them
+    bool fits(uint64_t count, size_t recordBytes) const { return count <= (bytes.size() - offset) / recordBytes; }
+    bool align() {
+        size_t padding = (BLOB_ALIGNMENT - offset % BLOB_ALIGNMENT) % BLOB_ALIGNMENT;
+        if (padding > bytes.size() - offset) return false;
+        offset += padding;
+        return true;
+    }
+
+private:
+    std::span<const uint8_t> bytes;
+    size_t offset = 0;
+};
+
+// every draw range of the mesh must lie inside the mapped arena and instance table
+bool isMeshInArena(const Mesh& mesh, size_t vertexStride, const MeshCacheHeader& header,
+                   std::span<const uint8_t> indexData) {
+    if (mesh.indexType != GL_UNSIGNED_SHORT && mesh.indexType != GL_UNSIGNED_INT) return false;
+    if (mesh.indexCount < 0 || mesh.vertexCount < 0 || mesh.baseVertex < 0 || mesh.instanceCount < 0) return false;
+    uint64_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    if ((uint64_t(mesh.firstIndex) + uint64_t(mesh.indexCount)) * indexSize > header.indexBytes) return false;
+    if ((uint64_t(mesh.baseVertex) + uint64_t(mesh.vertexCount)) * vertexStride > header.vertexBytes) return false;
+    if (uint64_t(mesh.firstInstance) + uint64_t(mesh.instanceCount) > header.instanceCount) return false;
+
+    // indices are relative to baseVertex and must stay within the primitive's vertices
+    const uint8_t* indices = indexData.data() + mesh.firstIndex * indexSize;
+    for (GLsizei i = 0; i < mesh.indexCount; ++i) {
+        uint32_t index;
+        if (indexSize == sizeof(uint16_t)) {
+            uint16_t narrow;
+            std::memcpy(&narrow, indices + i * indexSize, sizeof(narrow));
+            index = narrow;
+        } else {
+            std::memcpy(&index, indices + i * indexSize, sizeof(index));
+        }
+        if (index >= uint32_t(mesh.vertexCount)) return false;
+    }
+    return true;
+}
+
+// Every level must halve the one before it down to at most 1x1 and hold exactly the bytes its size
+// takes in format, so uploads never read past a level. Sides are capped well above any GL limit to
+// keep the byte count from overflowing.
+bool isTextureLevelChain(TextureFormat format, const std::vector<CachedTextureLevel>& table) {
+    constexpr uint32_t maxSide = 1u << 16;
+    for (size_t i = 0; i < table.size(); ++i) {
+        const CachedTextureLevel& entry = table[i];
+        if (entry.width == 0 || entry.height == 0 || entry.width > maxSide || entry.height > maxSide) return false;
+        if (i > 0) {
+            const CachedTextureLevel& previous = table[i - 1];
+            if (previous.width == 1 && previous.height == 1) return false;
+            if (entry.width != std::max(1u, previous.width / 2) || entry.height != std::max(1u, previous.height / 2))
+                return false;
+        }
+        if (entry.bytes != getTextureLevelBytes(format, entry.width, entry.height)) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string getMeshCachePath(const std::string& sourcePath) {
+    return sourcePath + ".meshcache";
+}
+
+bool writeMeshCache(const std::string& sourcePath, const std::vector<std::string>& bufferPaths, uint32_t options,
+                    const MeshCacheContents& contents) {
+    MeshCacheHeader header = {};
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.options = options;
+    header.source = getFileStamp(sourcePath);
+    if (!hashSource(sourcePath, header.sourceHash)) return false;
+    header.bufferCount = static_cast<uint32_t>(bufferPaths.size());
+    header.meshCount = static_cast<uint32_t>(contents.meshes.size());
+    header.instanceCount = static_cast<uint32_t>(contents.instanceTransforms.size());
+    header.textureCount = static_cast<uint32_t>(contents.texturePaths.size());
+    header.vertexBytes = contents.vertexData.size();
+    header.indexBytes = contents.indexData.size();
+    for (int c = 0; c < 3; ++c) {
+        header.minBounds[c] = contents.minBounds[c];
+        header.maxBounds[c] = contents.maxBounds[c];
+    }
+
+    // written aside and renamed into place, so a reader never maps a half-written cache
+    std::string cachePath = getMeshCachePath(sourcePath);
+    std::string tempPath = cachePath + ".tmp";
+    {
+        CacheWriter writer(tempPath);
+        if (!writer.ok()) {
+            std::cerr << "Failed to write mesh cache: " << cachePath << "\n";
+            return false;
+        }
+        writer.write(header);
+        for (const std::string& bufferPath : bufferPaths) {
+            writer.writeString(relativeToSource(bufferPath, sourcePath));
+            writer.write(getFileStamp(bufferPath));
+        }
+        for (size_t i = 0; i < contents.meshes.size(); ++i) {
+            const Mesh& mesh = contents.meshes[i];
+            CachedMesh cached = {};
+            cached.indexCount = static_cast<uint32_t>(mesh.indexCount);
+            cached.firstIndex = mesh.firstIndex;
+            cached.indexType = mesh.indexType;
+            cached.baseVertex = mesh.baseVertex;
+            cached.vertexCount = static_cast<uint32_t>(mesh.vertexCount);
+            cached.firstInstance = mesh.firstInstance;
+            cached.instanceCount = static_cast<uint32_t>(mesh.instanceCount);
+            for (int t = 0; t < 5; ++t) cached.textureSlots[t] = contents.meshTextureSlots[i][t];
+            for (int c = 0; c < 3; ++c) {
+                cached.boundsMin[c] = mesh.boundsMin[c];
+                cached.boundsMax[c] = mesh.boundsMax[c];
+            }
+            writer.write(cached);
+        }
+        for (const std::string& texturePath : contents.texturePaths) writer.writeString(texturePath);
+        writer.write(contents.instanceTransforms.data(), contents.instanceTransforms.size() * sizeof(glm::mat4));
+        writer.write(contents.gpuTransforms.data(), contents.gpuTransforms.size() * sizeof(glm::mat4));
+        writer.align();
+        writer.write(contents.vertexData.data(), contents.vertexData.size());
+        writer.align();
+        writer.write(contents.indexData.data(), contents.indexData.size());
+        if (!writer.ok()) {
+            std::cerr << "Failed to write mesh cache: " << cachePath << "\n";
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+bool readMeshCache(const std::string& sourcePath, uint32_t options, size_t vertexStride, MappedFile& file,
+                   MeshCacheContents& contents) {
+    if (!file.open(getMeshCachePath(sourcePath))) return false;
+
+    CacheReader reader(file.bytes());
+    MeshCacheHeader header;
+    if (!reader.read(header) || std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != MESH_CACHE_VERSION || header.options != options ||
+        !(header.source == getFileStamp(sourcePath))) {
+        file.close();
+        return false;
+    }
+    uint64_t sourceHash;
+    if (!hashSource(sourcePath, sourceHash) || sourceHash != header.sourceHash) {
+        file.close();
+        return false;
+    }
+
+    bool valid = true;
+    for (uint32_t b = 0; valid && b < header.bufferCount; ++b) {
+        std::string bufferPath;
+        FileStamp stamp;
+        valid = reader.readString(bufferPath) && reader.read(stamp) &&
+                stamp == getFileStamp(resolveFromSource(bufferPath, sourcePath));
+    }
+
+    contents = {};
+    // counts come from the file, so they are checked against what is left of it before any allocation
+    valid = valid && reader.fits(header.meshCount, sizeof(CachedMesh));
+    contents.meshes.resize(valid ? header.meshCount : 0);
+    contents.meshTextureSlots.resize(valid ? header.meshCount : 0);
+    for (uint32_t i = 0; valid && i < header.meshCount; ++i) {
+        CachedMesh cached;
+        valid = reader.read(cached);
+        if (!valid) break;
+        Mesh& mesh = contents.meshes[i];
+        mesh = Mesh{ 0, static_cast<GLsizei>(cached.indexCount), cached.firstIndex, cached.indexType,
+                     cached.baseVertex, static_cast<GLsizei>(cached.vertexCount), cached.firstInstance,
+                     static_cast<GLsizei>(cached.instanceCount) };
+        mesh.boundsMin = glm::vec3(cached.boundsMin[0], cached.boundsMin[1], cached.boundsMin[2]);
+        mesh.boundsMax = glm::vec3(cached.boundsMax[0], cached.boundsMax[1], cached.boundsMax[2]);
+        for (int t = 0; t < 5; ++t) {
+            contents.meshTextureSlots[i][t] = cached.textureSlots[t];
+            int32_t slot = cached.textureSlots[t];
+            valid = valid && slot >= -1 && slot < int32_t(header.textureCount);
+        }
+    }
+    valid = valid && reader.fits(header.textureCount, sizeof(uint32_t));
+    contents.texturePaths.resize(valid ? header.textureCount : 0);
+    for (uint32_t t = 0; valid && t < header.textureCount; ++t) valid = reader.readString(contents.texturePaths[t]);
+    valid = valid && reader.fits(header.instanceCount, 2 * sizeof(glm::mat4));
+    if (valid) {
+        contents.instanceTransforms.resize(header.instanceCount);
+        contents.gpuTransforms.resize(header.instanceCount);
+        valid = reader.read(contents.instanceTransforms.data(), header.instanceCount * sizeof(glm::mat4)) &&
+                reader.read(contents.gpuTransforms.data(), header.instanceCount * sizeof(glm::mat4)) &&
+                reader.align() && reader.view(header.vertexBytes, contents.vertexData) &&
+                reader.align() && reader.view(header.indexBytes, contents.indexData);
+    }
+    for (size_t i = 0; valid && i < contents.meshes.size(); ++i) {
+        valid = isMeshInArena(contents.meshes[i], vertexStride, header, contents.indexData);
+    }
+    if (!valid) {
+        contents = {};
+        file.close();
+        return false;
+    }
+
+    contents.minBounds = glm::vec3(header.minBounds[0], header.minBounds[1], header.minBounds[2]);
+    contents.maxBounds = glm::vec3(header.maxBounds[0], header.maxBounds[1], header.maxBounds[2]);
+    return true;
+}
+
+std::string getTextureCachePath(const std::string& imagePath) {
+    return imagePath + ".texcache";
+}
+
+bool writeTextureCache(const std::string& imagePath, TextureFormat format, const std::vector<TextureLevel>& levels) {
+    TextureCacheHeader header = {};
+    std::memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+    header.version = TEXTURE_CACHE_VERSION;
+    header.format = static_cast<uint32_t>(format);
+    header.source = getFileStamp(imagePath);
+    if (!hashSource(imagePath, header.sourceHash)) return false;
+    header.levelCount = static_cast<uint32_t>(levels.size());
+
+    std::string cachePath = getTextureCachePath(imagePath);
+    std::string tempPath = cachePath + ".tmp";
+    {
+        CacheWriter writer(tempPath);
+        if (!writer.ok()) {
+            std::cerr << "Failed to write texture cache: " + cachePath + "\n";
+            return false;
+        }
+        writer.write(header);
+        for (const TextureLevel& level : levels) {
+            writer.write(CachedTextureLevel{ level.width, level.height, level.data.size() });
+        }
+        for (const TextureLevel& level : levels) {
+            writer.align();
+            writer.write(level.data.data(), level.data.size());
+        }
+        if (!writer.ok()) {
+            std::cerr << "Failed to write texture cache: " + cachePath + "\n";
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+bool readTextureCache(const std::string& imagePath, MappedFile& file, TextureFormat& format,
+                      std::vector<TextureLevel>& levels) {
+    if (!file.open(getTextureCachePath(imagePath))) return false;
+
+    CacheReader reader(file.bytes());
+    TextureCacheHeader header;
+    uint64_t sourceHash;
+    bool valid = reader.read(header) && std::memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == TEXTURE_CACHE_VERSION &&
+                 header.format <= static_cast<uint32_t>(TextureFormat::BC5) &&
+                 header.source == getFileStamp(imagePath) && header.levelCount > 0 &&
+                 hashSource(imagePath, sourceHash) && sourceHash == header.sourceHash;
+
+    valid = valid && reader.fits(header.levelCount, sizeof(CachedTextureLevel));
+    std::vector<CachedTextureLevel> table(valid ? header.levelCount : 0);
+    for (CachedTextureLevel& entry : table) valid = valid && reader.read(entry);
+    valid = valid && isTextureLevelChain(static_cast<TextureFormat>(header.format), table);
+
+    levels.clear();
+    for (const CachedTextureLevel& entry : table) {
+        TextureLevel level{ entry.width, entry.height, {} };
+        valid = valid && reader.align() && reader.view(entry.bytes, level.data);
+        levels.push_back(level);
+    }
+    if (!valid) {
+        levels.clear();
+        file.close();
+        return false;
+    }
+    format = static_cast<TextureFormat>(header.format);
+    return true;
+}
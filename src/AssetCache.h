@@ -0,0 +1,102 @@
+#ifndef CLUSTEREDDEFERREDRENDERER_ASSETCACHE_H
+#define CLUSTEREDDEFERREDRENDERER_ASSETCACHE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Mesh;
+
+// read-only view of a whole file, memory-mapped where the platform allows it
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    std::span<const uint8_t> bytes() const { return { data, size }; }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    std::vector<uint8_t> buffer;
+#endif
+};
+
+// 64-bit FNV-1a
+uint64_t hashBytes(std::span<const uint8_t> bytes, uint64_t seed = 14695981039346656037ull);
+
+// identifies one version of a file on disk; size 0 and mtime 0 when it does not exist
+struct FileStamp {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+
+    bool operator==(const FileStamp&) const = default;
+};
+
+FileStamp getFileStamp(const std::string& path);
+
+// Everything ModelLoader::prepare produces for upload, in the form the mesh cache stores it. When
+// read back, vertexData and indexData point into the mapped cache file.
+struct MeshCacheContents {
+    std::vector<Mesh> meshes;                        // without VAO and texture IDs
+    std::vector<std::array<int, 5>> meshTextureSlots;
+    std::vector<std::string> texturePaths;           // relative to the asset's directory
+    std::vector<glm::mat4> instanceTransforms;
+    std::vector<glm::mat4> gpuTransforms;
+    glm::vec3 minBounds = glm::vec3(0.0f);
+    glm::vec3 maxBounds = glm::vec3(0.0f);
+    std::span<const uint8_t> vertexData;
+    std::span<const uint8_t> indexData;
+};
+
+// the cache sits next to the asset: scene.gltf -> scene.gltf.meshcache
+std::string getMeshCachePath(const std::string& sourcePath);
+
+// Writes the cache keyed on the source file's size, mtime and content hash plus the size and mtime
+// of every external buffer it references; options are the load flags the contents depend on.
+bool writeMeshCache(const std::string& sourcePath, const std::vector<std::string>& bufferPaths, uint32_t options,
+                    const MeshCacheContents& contents);
+
+// Maps the cache into file and fills contents if it exists and is still valid for the source and
+// options; file has to stay open while contents.vertexData/indexData are in use. A truncated or
+// inconsistent file, including a mesh whose draw ranges (vertexStride bytes per vertex) leave the
+// arena, is a miss.
+bool readMeshCache(const std::string& sourcePath, uint32_t options, size_t vertexStride, MappedFile& file,
+                   MeshCacheContents& contents);
+
+// pixel layout of a cached mip chain; the BC formats store 4x4 blocks, padded at the right and bottom edge
+enum class TextureFormat : uint32_t {
+    RGBA8 = 0,
+    BC1 = 1, // RGB, 8 bytes per block
+    BC3 = 2, // RGBA, 16 bytes per block
+    BC4 = 3, // one channel, 8 bytes per block
+    BC5 = 4, // two channels, 16 bytes per block
+};
+
+struct TextureLevel {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::span<const uint8_t> data;
+};
+
+// the cache sits next to the image: baseColor.png -> baseColor.png.texcache
+std::string getTextureCachePath(const std::string& imagePath);
+
+// Writes every mip level keyed on the image's size, mtime and content hash.
+bool writeTextureCache(const std::string& imagePath, TextureFormat format, const std::vector<TextureLevel>& levels);
+
+// Maps the cache into file and points levels at it when it is valid for the image; format reports
+// what the levels hold, the caller decides whether that is what it wants.
+bool readTextureCache(const std::string& imagePath, MappedFile& file, TextureFormat& format,
+                      std::vector<TextureLevel>& levels);
+
+#endif //CLUSTEREDDEFERREDRENDERER_ASSETCACHE_H
@@ -0,0 +1,180 @@
+#include "Benchmark.h"
+#include "TimingStats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <glm/gtc/constants.hpp>
+
+static bool parseOnOff(const char* value, bool& out) {
+    if (std::strcmp(value, "on") == 0) out = true;
+    else if (std::strcmp(value, "off") == 0) out = false;
+    else return false;
+    return true;
+}
+
+bool parseBenchmarkArgs(int argc, char** argv, BenchmarkOptions& options) {
+    auto usage = [&]() {
+        std::cerr << "usage: " << argv[0] << " --headless [--model path] [--frames N] [--warmup N]"
+                  << " [--size WxH] [--lights N] [--report path] [--depth-prepass on|off]"
+                  << " [--compact-gbuffer on|off] [--quantize on|off]"
+                  << " [--optimize-meshes on|off] [--overdraw on|off] [--mesh-cache on|off]"
+                  << " [--texture-cache on|off] [--compress-textures on|off]"
+                  << " [--trace path] [--trace-frames N]\n";
+        return false;
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (std::strcmp(arg, "--headless") == 0) {
+            continue;
+        }
+        if (!value) return usage();
+
+        if (std::strcmp(arg, "--model") == 0) {
+            options.modelPath = value;
+        } else if (std::strcmp(arg, "--report") == 0) {
+            options.reportPath = value;
+        } else if (std::strcmp(arg, "--depth-prepass") == 0) {
+            if (!parseOnOff(value, options.depthPrepass)) return usage();
+        } else if (std::strcmp(arg, "--compact-gbuffer") == 0) {
+            if (!parseOnOff(value, options.compactGBuffer)) return usage();
+        } else if (std::strcmp(arg, "--quantize") == 0) {
+            if (!parseOnOff(value, options.quantizeVertices)) return usage();
+        } else if (std::strcmp(arg, "--optimize-meshes") == 0) {
+            if (!parseOnOff(value, options.optimizeMeshes)) return usage();
+        } else if (std::strcmp(arg, "--overdraw") == 0) {
+            if (!parseOnOff(value, options.reduceOverdraw)) return usage();
+        } else if (std::strcmp(arg, "--mesh-cache") == 0) {
+            if (!parseOnOff(value, options.meshCache)) return usage();
+        } else if (std::strcmp(arg, "--texture-cache") == 0) {
+            if (!parseOnOff(value, options.textureCache)) return usage();
+        } else if (std::strcmp(arg, "--compress-textures") == 0) {
+            if (!parseOnOff(value, options.compressTextures)) return usage();
+        } else if (std::strcmp(arg, "--trace") == 0) {
+            options.tracePath = value;
+        } else if (std::strcmp(arg, "--trace-frames") == 0) {
+            options.traceFrames = std::atoi(value);
+        } else if (std::strcmp(arg, "--frames") == 0) {
+            options.frames = std::atoi(value);
+        } else if (std::strcmp(arg, "--warmup") == 0) {
+            options.warmupFrames = std::atoi(value);
+        } else if (std::strcmp(arg, "--lights") == 0) {
+            options.extraLights = std::atoi(value);
+        } else if (std::strcmp(arg, "--size") == 0) {
+            if (std::sscanf(value, "%dx%d", &options.width, &options.height) != 2) return usage();
+        } else {
+            return usage();
+        }
+        ++i;
+    }
+
+    if (options.frames <= 0 || options.width <= 0 || options.height <= 0 ||
+        options.warmupFrames < 0 || options.extraLights < 0 || options.traceFrames <= 0) {
+        return usage();
+    }
+    return true;
+}
+
+glm::vec3 getBenchmarkCameraPosition(int frame, int frameCount) {
+    // Scene normalizes models to unit size around the origin, so a radius of 2 frames it fully
+    float t = float(frame) / float(std::max(frameCount, 1));
+    float angle = t * 2.0f * glm::pi<float>();
+    float height = 0.5f + 0.25f * std::sin(2.0f * angle);
+    return glm::vec3(2.0f * std::sin(angle), height, 2.0f * std::cos(angle));
+}
+
+namespace {
+
+void writeSummary(std::ostream& out, const TimingSummary& s) {
+    out << "{\"count\": " << s.count << ", \"avg\": " << s.avg << ", \"min\": " << s.min
+        << ", \"max\": " << s.max << ", \"p50\": " << s.p50 << ", \"p95\": " << s.p95
+        << ", \"p99\": " << s.p99 << "}";
+}
+
+std::string escape(const std::string& str) {
+    std::string escaped;
+    for (char c : str) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+    }
+    return escaped;
+}
+
+} // namespace
+
+bool writeBenchmarkReport(const BenchmarkOptions& options, const BenchmarkResults& results) {
+    std::ofstream out(options.reportPath);
+    if (!out) {
+        std::cerr << "Failed to write benchmark report: " << options.reportPath << "\n";
+        return false;
+    }
+
+    auto measured = [&](uint64_t frame) { return frame >= static_cast<uint64_t>(options.warmupFrames); };
+
+    std::vector<double> frameSamples;
+    for (size_t i = 0; i < results.frameCpuMs.size(); ++i) {
+        if (measured(i)) frameSamples.push_back(results.frameCpuMs[i]);
+    }
+
+    out << "{\n";
+    out << "  \"model\": \"" << escape(options.modelPath) << "\",\n";
+    out << "  \"width\": " << options.width << ",\n";
+    out << "  \"height\": " << options.height << ",\n";
+    out << "  \"frames\": " << options.frames << ",\n";
+    out << "  \"warmup_frames\": " << options.warmupFrames << ",\n";
+    out << "  \"lights\": " << results.lightCount << ",\n";
+    out << "  \"depth_prepass\": " << (options.depthPrepass ? "true" : "false") << ",\n";
+    out << "  \"compact_gbuffer\": " << (options.compactGBuffer ? "true" : "false") << ",\n";
+    out << "  \"quantized_vertices\": " << (options.quantizeVertices ? "true" : "false") << ",\n";
+    out << "  \"optimized_meshes\": " << (options.optimizeMeshes ? "true" : "false") << ",\n";
+    out << "  \"overdraw_order\": " << (options.reduceOverdraw ? "true" : "false") << ",\n";
+    out << "  \"mesh_cache\": " << (options.meshCache ? "true" : "false") << ",\n";
+    out << "  \"texture_cache\": " << (options.textureCache ? "true" : "false") << ",\n";
+    out << "  \"compress_textures\": " << (options.compressTextures ? "true" : "false") << ",\n";
+    out << "  \"gl_renderer\": \"" << escape(results.glRenderer) << "\",\n";
+    out << "  \"gl_version\": \"" << escape(results.glVersion) << "\",\n";
+    out << "  \"frame_cpu_ms\": ";
+    writeSummary(out, summarizeTimings(frameSamples));
+    out << ",\n  \"passes\": {\n";
+
+    for (int pass = 0; pass < RENDER_PASS_COUNT; ++pass) {
+        std::vector<double> cpu, gpu;
+        for (const FrameTiming& timing : results.passTimings) {
+            if (!measured(timing.frame)) continue;
+            if (timing.cpuMs[pass] >= 0.0) cpu.push_back(timing.cpuMs[pass]);
+            if (timing.gpuMs[pass] >= 0.0) gpu.push_back(timing.gpuMs[pass]);
+        }
+        out << "    \"" << getRenderPassName(static_cast<RenderPass>(pass)) << "\": {\"cpu_ms\": ";
+        writeSummary(out, summarizeTimings(cpu));
+        out << ", \"gpu_ms\": ";
+        writeSummary(out, summarizeTimings(gpu));
+        out << "}" << (pass + 1 < RENDER_PASS_COUNT ? "," : "") << "\n";
+    }
+    out << "  },\n";
+
+    // raw per-frame samples so regressions can be inspected beyond the summary
+    out << "  \"per_frame\": [\n";
+    for (size_t i = 0; i < results.passTimings.size(); ++i) {
+        const FrameTiming& timing = results.passTimings[i];
+        out << "    {\"frame\": " << timing.frame;
+        if (timing.frame < results.frameCpuMs.size()) {
+            out << ", \"frame_cpu_ms\": " << results.frameCpuMs[timing.frame];
+        }
+        for (int pass = 0; pass < RENDER_PASS_COUNT; ++pass) {
+            const char* name = getRenderPassName(static_cast<RenderPass>(pass));
+            out << ", \"" << name << "_cpu_ms\": " << timing.cpuMs[pass]
+                << ", \"" << name << "_gpu_ms\": " << timing.gpuMs[pass];
+        }
+        out << "}" << (i + 1 < results.passTimings.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+
+    std::cout << "Benchmark report written to " << options.reportPath << "\n";
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,50 @@
+#ifndef CLUSTEREDDEFERREDRENDERER_BENCHMARK_H
+#define CLUSTEREDDEFERREDRENDERER_BENCHMARK_H
+
+#include "PassTimer.h"
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// settings for a headless run: fixed model, scripted camera, fixed number of frames
+struct BenchmarkOptions {
+    std::string modelPath = "assets/models/backpack/scene.gltf";
+    std::string reportPath = "benchmark.json";
+    int frames = 600;
+    int warmupFrames = 30;   // rendered but left out of the summary
+    int width = 1280;
+    int height = 720;
+    int extraLights = 0;     // random lights added on top of the scene's defaults
+    bool depthPrepass = false;
+    bool compactGBuffer = true;    // off: the wide RGB16F position/normal G-buffer
+    bool quantizeVertices = false;
+    bool optimizeMeshes = false;
+    bool reduceOverdraw = false;   // only applies together with optimizeMeshes
+    bool meshCache = true;         // load from / write <model>.meshcache
+    bool textureCache = true;      // load from / write <image>.texcache
+    bool compressTextures = false; // BC-compress textures at bake time
+    std::string tracePath;   // when set, CPU zones are profiled and dumped here as a Chrome trace
+    int traceFrames = 120;   // how many of the final frames the trace covers
+};
+
+// parses "--headless [--model path] [--frames N] [--warmup N] [--size WxH] [--lights N] [--report path]
+// [--depth-prepass on|off] [--compact-gbuffer on|off] [--quantize on|off] [--optimize-meshes on|off]
+// [--overdraw on|off] [--mesh-cache on|off] [--texture-cache on|off] [--compress-textures on|off]
+// [--trace path] [--trace-frames N]";
+// returns false and prints usage when an argument is malformed
+bool parseBenchmarkArgs(int argc, char** argv, BenchmarkOptions& options);
+
+// camera position for a frame of the scripted path: one full orbit around the normalized model
+glm::vec3 getBenchmarkCameraPosition(int frame, int frameCount);
+
+struct BenchmarkResults {
+    std::string glRenderer;
+    std::string glVersion;
+    size_t lightCount = 0;
+    std::vector<double> frameCpuMs;
+    std::vector<FrameTiming> passTimings;
+};
+
+bool writeBenchmarkReport(const BenchmarkOptions& options, const BenchmarkResults& results);
+
+#endif //CLUSTEREDDEFERREDRENDERER_BENCHMARK_H
@@ -0,0 +1,349 @@
+#include "ClusterCulling.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CLUSTER_CULLING_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CLUSTER_CULLING_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CLUSTER_CULLING_TARGET_AVX2
+#endif
+
+ClusterAABB transformAABB(const glm::vec3& min, const glm::vec3& max, const glm::mat4& transform) {
+    glm::vec3 center = glm::vec3(transform * glm::vec4(0.5f * (min + max), 1.0f));
+    glm::vec3 extent = 0.5f * (max - min);
+    glm::mat3 absolute(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])),
+                       glm::abs(glm::vec3(transform[2])));
+    glm::vec3 newExtent = absolute * extent;
+    return { center - newExtent, center + newExtent };
+}
+
+bool sphereIntersectsAABB(const glm::vec3& center, float radius, const glm::vec3& aabbMin, const glm::vec3& aabbMax) {
+    float distSquared = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        if (center[i] < aabbMin[i]) {
+            distSquared += (aabbMin[i] - center[i]) * (aabbMin[i] - center[i]);
+        } else if (center[i] > aabbMax[i]) {
+            distSquared += (center[i] - aabbMax[i]) * (center[i] - aabbMax[i]);
+        }
+    }
+
+    return distSquared <= radius * radius;
+}
+
+void AABBSoA::resize(int newCount) {
+    count = newCount;
+    // one spare block so unaligned 8-wide loads near the end never run off the lane
+    blocksPerLane = (newCount + 7) / 8 + 1;
+    storage.assign(6 * blocksPerLane, Block{});
+}
+
+void AABBSoA::set(int idx, const glm::vec3& min, const glm::vec3& max) {
+    lane(0)[idx] = min.x;
+    lane(1)[idx] = min.y;
+    lane(2)[idx] = min.z;
+    lane(3)[idx] = max.x;
+    lane(4)[idx] = max.y;
+    lane(5)[idx] = max.z;
+}
+
+ClusterAABB AABBSoA::get(int idx) const {
+    return {
+            glm::vec3(minX()[idx], minY()[idx], minZ()[idx]),
+            glm::vec3(maxX()[idx], maxY()[idx], maxZ()[idx])
+    };
+}
+
+static uint32_t sphereClustersScalar(const AABBSoA& bounds, int first, int count,
+                                     const glm::vec3& center, float radius) {
+    uint32_t mask = 0;
+    for (int i = 0; i < count; ++i) {
+        ClusterAABB aabb = bounds.get(first + i);
+        if (sphereIntersectsAABB(center, radius, aabb.min, aabb.max)) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+FrustumPlanes extractFrustumPlanes(const glm::mat4& viewProjection) {
+    // Gribb-Hartmann: each clip-space bound -w <= x, y, z <= w is a row combination of the matrix
+    glm::vec4 rowX(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    glm::vec4 rowY(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    glm::vec4 rowZ(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    glm::vec4 rowW(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+    return {{ rowW + rowX, rowW - rowX, rowW + rowY, rowW - rowY, rowW + rowZ, rowW - rowZ }};
+}
+
+// A box is outside when its corner furthest along a plane's normal (the "positive vertex") is
+// behind that plane. The normal's signs are the same for every box, so each plane just picks the
+// min or max lane per axis and the test needs no per-box selects.
+static int frustumAABBsScalar(const AABBSoA& bounds, const FrustumPlanes& frustum, uint32_t* visible) {
+    int count = bounds.size();
+    std::fill(visible, visible + (count + 31) / 32, 0u);
+    int visibleCount = 0;
+    for (int i = 0; i < count; ++i) {
+        bool inside = true;
+        for (const glm::vec4& plane : frustum.planes) {
+            float px = plane.x > 0.0f ? bounds.maxX()[i] : bounds.minX()[i];
+            float py = plane.y > 0.0f ? bounds.maxY()[i] : bounds.minY()[i];
+            float pz = plane.z > 0.0f ? bounds.maxZ()[i] : bounds.minZ()[i];
+            inside = inside && plane.x * px + plane.y * py + plane.z * pz + plane.w >= 0.0f;
+        }
+        if (inside) {
+            visible[i / 32] |= 1u << (i % 32);
+            ++visibleCount;
+        }
+    }
+    return visibleCount;
+}
+
+#ifdef CLUSTER_CULLING_X86
+
+// Per axis the scalar test adds (min - c)^2 below the box, (c - max)^2 above it and nothing inside.
+// max(min - c, c - max, 0) picks the same difference, and the squares are summed in x, y, z order
+// without FMA, so the comparison sees exactly the value sphereIntersectsAABB computes.
+static uint32_t sphereClustersSSE2(const AABBSoA& bounds, int first, int count,
+                                   const glm::vec3& center, float radius) {
+    const __m128 cx = _mm_set1_ps(center.x);
+    const __m128 cy = _mm_set1_ps(center.y);
+    const __m128 cz = _mm_set1_ps(center.z);
+    const __m128 r2 = _mm_set1_ps(radius * radius);
+    const __m128 zero = _mm_setzero_ps();
+
+    uint32_t mask = 0;
+    for (int i = 0; i < count; i += 4) {
+        int idx = first + i;
+        __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(bounds.minX() + idx), cx),
+                                          _mm_sub_ps(cx, _mm_loadu_ps(bounds.maxX() + idx))), zero);
+        __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(bounds.minY() + idx), cy),
+                                          _mm_sub_ps(cy, _mm_loadu_ps(bounds.maxY() + idx))), zero);
+        __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(bounds.minZ() + idx), cz),
+                                          _mm_sub_ps(cz, _mm_loadu_ps(bounds.maxZ() + idx))), zero);
+        __m128 distSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        mask |= uint32_t(_mm_movemask_ps(_mm_cmple_ps(distSquared, r2))) << i;
+    }
+    return count < 32 ? mask & ((1u << count) - 1u) : mask;
+}
+
+CLUSTER_CULLING_TARGET_AVX2
+static uint32_t sphereClustersAVX2(const AABBSoA& bounds, int first, int count,
+                                   const glm::vec3& center, float radius) {
+    const __m256 cx = _mm256_set1_ps(center.x);
+    const __m256 cy = _mm256_set1_ps(center.y);
+    const __m256 cz = _mm256_set1_ps(center.z);
+    const __m256 r2 = _mm256_set1_ps(radius * radius);
+    const __m256 zero = _mm256_setzero_ps();
+
+    uint32_t mask = 0;
+    for (int i = 0; i < count; i += 8) {
+        int idx = first + i;
+        __m256 dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds.minX() + idx), cx),
+                                                _mm256_sub_ps(cx, _mm256_loadu_ps(bounds.maxX() + idx))), zero);
+        __m256 dy = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds.minY() + idx), cy),
+                                                _mm256_sub_ps(cy, _mm256_loadu_ps(bounds.maxY() + idx))), zero);
+        __m256 dz = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds.minZ() + idx), cz),
+                                                _mm256_sub_ps(cz, _mm256_loadu_ps(bounds.maxZ() + idx))), zero);
+        __m256 distSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                                           _mm256_mul_ps(dz, dz));
+        mask |= uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(distSquared, r2, _CMP_LE_OQ))) << i;
+    }
+    return count < 32 ? mask & ((1u << count) - 1u) : mask;
+}
+
+// same arithmetic as frustumAABBsScalar, in the same order and without FMA
+static int frustumAABBsSSE2(const AABBSoA& bounds, const FrustumPlanes& frustum, uint32_t* visible) {
+    int count = bounds.size();
+    std::fill(visible, visible + (count + 31) / 32, 0u);
+    for (int i = 0; i < count; i += 4) {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 px = _mm_loadu_ps((plane.x > 0.0f ? bounds.maxX() : bounds.minX()) + i);
+            __m128 py = _mm_loadu_ps((plane.y > 0.0f ? bounds.maxY() : bounds.minY()) + i);
+            __m128 pz = _mm_loadu_ps((plane.z > 0.0f ? bounds.maxZ() : bounds.minZ()) + i);
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), px),
+                                                           _mm_mul_ps(_mm_set1_ps(plane.y), py)),
+                                                _mm_mul_ps(_mm_set1_ps(plane.z), pz)),
+                                     _mm_set1_ps(plane.w));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+        }
+        visible[i / 32] |= uint32_t(_mm_movemask_ps(inside)) << (i % 32);
+    }
+    // the padding past count is zero-filled and may have passed; it is not a real box
+    if (count % 32) visible[count / 32] &= (1u << (count % 32)) - 1u;
+
+    int visibleCount = 0;
+    for (int w = 0; w < (count + 31) / 32; ++w) visibleCount += std::popcount(visible[w]);
+    return visibleCount;
+}
+
+CLUSTER_CULLING_TARGET_AVX2
+static int frustumAABBsAVX2(const AABBSoA& bounds, const FrustumPlanes& frustum, uint32_t* visible) {
+    int count = bounds.size();
+    std::fill(visible, visible + (count + 31) / 32, 0u);
+    for (int i = 0; i < count; i += 8) {
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const glm::vec4& plane : frustum.planes) {
+            __m256 px = _mm256_loadu_ps((plane.x > 0.0f ? bounds.maxX() : bounds.minX()) + i);
+            __m256 py = _mm256_loadu_ps((plane.y > 0.0f ? bounds.maxY() : bounds.minY()) + i);
+            __m256 pz = _mm256_loadu_ps((plane.z > 0.0f ? bounds.maxZ() : bounds.minZ()) + i);
+            __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), px),
+                                                                    _mm256_mul_ps(_mm256_set1_ps(plane.y), py)),
+                                                      _mm256_mul_ps(_mm256_set1_ps(plane.z), pz)),
+                                        _mm256_set1_ps(plane.w));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        visible[i / 32] |= uint32_t(_mm256_movemask_ps(inside)) << (i % 32);
+    }
+    if (count % 32) visible[count / 32] &= (1u << (count % 32)) - 1u;
+
+    int visibleCount = 0;
+    for (int w = 0; w < (count + 31) / 32; ++w) visibleCount += std::popcount(visible[w]);
+    return visibleCount;
+}
+
+static bool cpuSupportsAVX2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // CLUSTER_CULLING_X86
+
+CullingKernelType detectCullingKernel() {
+#ifdef CLUSTER_CULLING_X86
+    return cpuSupportsAVX2() ? CullingKernelType::AVX2 : CullingKernelType::SSE2;
+#else
+    return CullingKernelType::Scalar;
+#endif
+}
+
+SphereClustersKernel getSphereClustersKernel(CullingKernelType type) {
+    switch (type) {
+#ifdef CLUSTER_CULLING_X86
+        case CullingKernelType::AVX2: return sphereClustersAVX2;
+        case CullingKernelType::SSE2: return sphereClustersSSE2;
+#endif
+        default: return sphereClustersScalar;
+    }
+}
+
+FrustumAABBsKernel getFrustumAABBsKernel(CullingKernelType type) {
+    switch (type) {
+#ifdef CLUSTER_CULLING_X86
+        case CullingKernelType::AVX2: return frustumAABBsAVX2;
+        case CullingKernelType::SSE2: return frustumAABBsSSE2;
+#endif
+        default: return frustumAABBsScalar;
+    }
+}
+
+const char* getCullingKernelName(CullingKernelType type) {
+    switch (type) {
+        case CullingKernelType::AVX2: return "AVX2";
+        case CullingKernelType::SSE2: return "SSE2";
+        default: return "Scalar";
+    }
+}
+
+int runClusterCullingBenchmark() {
+    // same 16x9x24 logarithmic grid the renderer builds for a 16:9 window
+    const int clusterX = 16, clusterY = 9, clusterZ = 24;
+    const int clusterCount = clusterX * clusterY * clusterZ;
+    const float nearPlane = 0.1f, farPlane = 100.0f;
+    const float tanHalfFovY = std::tan(glm::radians(22.5f));
+    const float tanHalfFovX = tanHalfFovY * 16.0f / 9.0f;
+
+    std::vector<ClusterAABB> aabbs(clusterCount);
+    AABBSoA soa;
+    soa.resize(clusterCount);
+    for (int z = 0; z < clusterZ; ++z) {
+        float zNear = nearPlane * std::pow(farPlane / nearPlane, float(z) / clusterZ);
+        float zFar  = nearPlane * std::pow(farPlane / nearPlane, float(z + 1) / clusterZ);
+        for (int y = 0; y < clusterY; ++y) {
+            for (int x = 0; x < clusterX; ++x) {
+                float x0 = 2.0f * float(x) / clusterX - 1.0f, x1 = 2.0f * float(x + 1) / clusterX - 1.0f;
+                float y0 = 2.0f * float(y) / clusterY - 1.0f, y1 = 2.0f * float(y + 1) / clusterY - 1.0f;
+                int idx = x + clusterX * (y + clusterY * z);
+                aabbs[idx].min = glm::vec3(std::min(x0 * zNear, x0 * zFar) * tanHalfFovX,
+                                           std::min(y0 * zNear, y0 * zFar) * tanHalfFovY, -zFar);
+                aabbs[idx].max = glm::vec3(std::max(x1 * zNear, x1 * zFar) * tanHalfFovX,
+                                           std::max(y1 * zNear, y1 * zFar) * tanHalfFovY, -zNear);
+                soa.set(idx, aabbs[idx].min, aabbs[idx].max);
+            }
+        }
+    }
+
+    std::vector<CullingKernelType> kernels = { CullingKernelType::Scalar };
+#ifdef CLUSTER_CULLING_X86
+    kernels.push_back(CullingKernelType::SSE2);
+    if (cpuSupportsAVX2()) kernels.push_back(CullingKernelType::AVX2);
+#endif
+
+    const int iterations = 10;
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> lateral(-30.0f, 30.0f), depth(-100.0f, 0.0f), radius(0.5f, 10.0f);
+
+    std::printf("%-8s %-10s %12s %12s %10s\n", "lights", "path", "ms/frame", "hits", "speedup");
+    for (int lightCount : { 256, 1024, 4096 }) {
+        std::vector<glm::vec4> lights(lightCount);
+        for (glm::vec4& light : lights) {
+            light = glm::vec4(lateral(rng), lateral(rng), depth(rng), radius(rng));
+        }
+
+        // baseline: the AoS array walked with the branchy scalar test
+        size_t referenceHits = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int it = 0; it < iterations; ++it) {
+            referenceHits = 0;
+            for (const glm::vec4& light : lights) {
+                for (const ClusterAABB& aabb : aabbs) {
+                    referenceHits += sphereIntersectsAABB(glm::vec3(light), light.w, aabb.min, aabb.max);
+                }
+            }
+        }
+        double referenceMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+        std::printf("%-8d %-10s %12.3f %12zu %10s\n", lightCount, "AoS", referenceMs, referenceHits, "1.00x");
+
+        for (CullingKernelType type : kernels) {
+            SphereClustersKernel kernel = getSphereClustersKernel(type);
+            size_t hits = 0;
+            start = std::chrono::steady_clock::now();
+            for (int it = 0; it < iterations; ++it) {
+                hits = 0;
+                for (const glm::vec4& light : lights) {
+                    for (int first = 0; first < clusterCount; first += 32) {
+                        int count = std::min(32, clusterCount - first);
+                        hits += std::popcount(kernel(soa, first, count, glm::vec3(light), light.w));
+                    }
+                }
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+            std::printf("%-8d %-10s %12.3f %12zu %9.2fx%s\n", lightCount, getCullingKernelName(type), ms, hits,
+                        referenceMs / ms, hits == referenceHits ? "" : "  MISMATCH");
+            if (hits != referenceHits) return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef CLUSTEREDDEFERREDRENDERER_CLUSTERCULLING_H
+#define CLUSTEREDDEFERREDRENDERER_CLUSTERCULLING_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct ClusterAABB {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// box enclosing the transformed box (Arvo's method); exact for translations and axis-aligned scales
+ClusterAABB transformAABB(const glm::vec3& min, const glm::vec3& max, const glm::mat4& transform);
+
+bool sphereIntersectsAABB(const glm::vec3& center, float radius, const glm::vec3& aabbMin, const glm::vec3& aabbMax);
+
+// axis-aligned boxes (cluster or mesh bounds) as six separate float arrays, each 32-byte aligned
+// and padded so an 8-wide load starting at any valid index stays inside the allocation
+class AABBSoA {
+public:
+    void resize(int count);
+    void set(int idx, const glm::vec3& min, const glm::vec3& max);
+    ClusterAABB get(int idx) const;
+    int size() const { return count; }
+
+    const float* minX() const { return lane(0); }
+    const float* minY() const { return lane(1); }
+    const float* minZ() const { return lane(2); }
+    const float* maxX() const { return lane(3); }
+    const float* maxY() const { return lane(4); }
+    const float* maxZ() const { return lane(5); }
+
+private:
+    struct alignas(32) Block { float v[8]; };
+
+    float* lane(int i) { return reinterpret_cast<float*>(storage.data() + i * blocksPerLane); }
+    const float* lane(int i) const { return reinterpret_cast<const float*>(storage.data() + i * blocksPerLane); }
+
+    std::vector<Block> storage;
+    int count = 0;
+    int blocksPerLane = 0;
+};
+
+// Tests one sphere against clusters [first, first + count), count <= 32, and returns a bitmask
+// with bit i set when cluster first + i intersects. Every kernel gives the same result as
+// sphereIntersectsAABB, bit for bit.
+using SphereClustersKernel = uint32_t (*)(const AABBSoA& bounds, int first, int count,
+                                          const glm::vec3& center, float radius);
+
+// six planes (left, right, bottom, top, near, far) as (normal, d); a point p is inside a plane
+// when dot(normal, p) + d >= 0. The normals are not normalized, only the sign is used.
+struct FrustumPlanes {
+    glm::vec4 planes[6];
+};
+
+FrustumPlanes extractFrustumPlanes(const glm::mat4& viewProjection);
+
+// Tests every box in bounds against the frustum and sets bit i of visible[i / 32] when box i is
+// at least partially inside (conservative: boxes near a frustum corner may pass). visible must
+// hold (bounds.size() + 31) / 32 words. Returns the number of visible boxes.
+using FrustumAABBsKernel = int (*)(const AABBSoA& bounds, const FrustumPlanes& frustum, uint32_t* visible);
+
+enum class CullingKernelType { Scalar, SSE2, AVX2 };
+
+CullingKernelType detectCullingKernel();
+SphereClustersKernel getSphereClustersKernel(CullingKernelType type);
+FrustumAABBsKernel getFrustumAABBsKernel(CullingKernelType type);
+const char* getCullingKernelName(CullingKernelType type);
+
+// microbenchmark of the AoS scalar test against the SoA kernels, printed to stdout
+int runClusterCullingBenchmark();
+
+#endif //CLUSTEREDDEFERREDRENDERER_CLUSTERCULLING_H
@@ -3,29 +3,38 @@
 //
 
 #include "DeferredRenderer.h"
+#include "Profiler.h"
 #include <iostream>
+#include <algorithm>
+#include <bit>
 #include <glm/gtc/type_ptr.hpp>
-
-bool sphereIntersectsAABB(const glm::vec3& center, float radius, const glm::vec3& aabbMin, const glm::vec3& aabbMax) {
-    float distSquared = 0.0f;
-    for (int i = 0; i < 3; ++i) {
-        if (center[i] < aabbMin[i]) {
-            distSquared += (aabbMin[i] - center[i]) * (aabbMin[i] - center[i]);
-        } else if (center[i] > aabbMax[i]) {
-            distSquared += (center[i] - aabbMax[i]) * (center[i] - aabbMax[i]);
-        }
-    }
-
-    return distSquared <= radius * radius;
+#include <cstddef>
+
+// Scene::lights is uploaded to the light buffer without repacking
+static_assert(sizeof(Light) == 2 * sizeof(glm::vec4), "Light must be two tightly packed vec4s");
+static_assert(offsetof(Light, radius) == 12 && offsetof(Light, color) == 16 && offsetof(Light, intensity) == 28,
+              "Light layout must match the (position, radius), (color, intensity) texels");
+
+// Conservative [first, last] tile range overlapped by [center - radius, center + radius] along one axis
+// of a slice spanning view depths [zNear, zFar]. At depth z, tile i covers
+// tanHalfFov * z * [2i/n - 1, 2(i+1)/n - 1]; the range is padded by a tile so float rounding can never
+// drop a cluster that sphereIntersectsAABB would accept.
+static void tileRange(float center, float radius, float tanHalfFov, float zNear, float zFar, int tileCount,
+                      int& first, int& last) {
+    float lo = center - radius;
+    float hi = center + radius;
+    float loTile = (lo / (tanHalfFov * (lo >= 0.0f ? zFar : zNear)) + 1.0f) * 0.5f * float(tileCount);
+    float hiTile = (hi / (tanHalfFov * (hi >= 0.0f ? zNear : zFar)) + 1.0f) * 0.5f * float(tileCount);
+    first = std::max(int(std::floor(loTile)) - 1, 0);
+    last = std::min(int(std::ceil(hiTile)), tileCount - 1);
 }
 
 DeferredRenderer::DeferredRenderer(int width, int height, const Camera& camera)
-        : screenWidth(width), screenHeight(height), quadVAO(0), quadVBO(0),
+        : screenWidth(width), screenHeight(height),
+          depthShader("shaders/depth.vert", "shaders/depth.frag"),
           geometryShader("shaders/geometry.vert", "shaders/geometry.frag"),
           lightingShader("shaders/lighting.vert", "shaders/lighting.frag") {
-    int numClusters = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
-    clusterLightCounts.resize(numClusters, 0);
-    clusterLightIndices.resize(numClusters * MAX_LIGHTS_PER_CLUSTER, -1);
+    clusterGrid.resize(CLUSTER_X * CLUSTER_Y * CLUSTER_Z, glm::uvec2(0));
 
     float nearPlane = 0.1f;
     float farPlane = 100.0f;
@@ -33,15 +42,19 @@ DeferredRenderer::DeferredRenderer(int width, int height, const Camera& camera)
     computeClusterBounds(camera.Zoom, aspect, nearPlane, farPlane);
 
     initGBuffer();
+    initClusterBuffers();
+    initGeometryShader();
+    initLightingShader();
 }
 
 DeferredRenderer::~DeferredRenderer() {
-    glDeleteFramebuffers(1, &gBuffer);
-    glDeleteTextures(1, &gPosition);
-    glDeleteTextures(1, &gNormal);
-    glDeleteTextures(1, &gAlbedoSpec);
-    glDeleteTextures(1, &clusterLightTexture);
-    glDeleteRenderbuffers(1, &rboDepth);
+    deleteGBuffer();
+    glDeleteTextures(1, &clusterGridTexture);
+    glDeleteTextures(1, &clusterLightListTexture);
+    glDeleteBuffers(1, &clusterLightListBuffer);
+    glDeleteTextures(1, &lightTexture);
+    glDeleteBuffers(1, &lightBuffer);
+    glDeleteBuffers(1, &lightingParamsUBO);
 
     if (quadVAO != 0) {
         glDeleteVertexArrays(1, &quadVAO);
@@ -49,27 +62,25 @@ DeferredRenderer::~DeferredRenderer() {
     }
 }
 
+// Compact layout, 12 bytes/pixel instead of 20: view-space position is rebuilt from the depth
+// texture in lighting.frag, normals are octahedral-encoded into two 16-bit channels. The wide
+// layout stores both as RGB16F instead; the depth texture and albedo target are shared.
 void DeferredRenderer::initGBuffer() {
     glGenFramebuffers(1, &gBuffer);
     glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
 
-    glGenTextures(1, &gPosition);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, screenWidth, screenHeight, 0, GL_RGB, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
-
     glGenTextures(1, &gNormal);
     glBindTexture(GL_TEXTURE_2D, gNormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, screenWidth, screenHeight, 0, GL_RGB, GL_FLOAT, NULL);
+    if (compactGBuffer) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, screenWidth, screenHeight, 0, GL_RG, GL_UNSIGNED_SHORT, NULL);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, screenWidth, screenHeight, 0, GL_RGB, GL_FLOAT, NULL);
+    }
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gNormal, 0);
 
     glGenTextures(1, &gAlbedoSpec);
     glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
@@ -78,55 +89,217 @@ void DeferredRenderer::initGBuffer() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedoSpec, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gAlbedoSpec, 0);
+
+    if (!compactGBuffer) {
+        glGenTextures(1, &gPosition);
+        glBindTexture(GL_TEXTURE_2D, gPosition);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, screenWidth, screenHeight, 0, GL_RGB, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gPosition, 0);
+    }
 
     GLuint attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-    glDrawBuffers(3, attachments);
+    glDrawBuffers(compactGBuffer ? 2 : 3, attachments);
 
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, screenWidth, screenHeight);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+    glGenTextures(1, &gDepth);
+    glBindTexture(GL_TEXTURE_2D, gDepth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, screenWidth, screenHeight, 0,
+                 GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
 
     GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
     if (status != GL_FRAMEBUFFER_COMPLETE) {
         std::cerr << "Framebuffer not complete! Status: " << std::hex << status << std::endl;
     }
 
+    glBindTexture(GL_TEXTURE_2D, 0);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DeferredRenderer::deleteGBuffer() {
+    glDeleteFramebuffers(1, &gBuffer);
+    glDeleteTextures(1, &gNormal);
+    glDeleteTextures(1, &gAlbedoSpec);
+    glDeleteTextures(1, &gDepth);
+    if (gPosition != 0) {
+        glDeleteTextures(1, &gPosition);
+        gPosition = 0;
+    }
+}
 
-    glGenTextures(1, &clusterLightTexture);
-    glBindTexture(GL_TEXTURE_2D, clusterLightTexture);
+void DeferredRenderer::setCompactGBuffer(bool enabled) {
+    if (enabled == compactGBuffer) return;
+    compactGBuffer = enabled;
+    deleteGBuffer();
+    initGBuffer();
+    setGBufferLayoutUniforms();
+}
+
+void DeferredRenderer::setGBufferLayoutUniforms() {
+    geometryShader.use();
+    geometryShader.setBool("compactGBuffer", compactGBuffer);
+    lightingShader.use();
+    lightingShader.setBool("compactGBuffer", compactGBuffer);
+    glUseProgram(0);
+}
+
+void DeferredRenderer::initClusterBuffers() {
+    // one row per Z slice, X-major within the row, matching clusterIdx ordering
+    glGenTextures(1, &clusterGridTexture);
+    glBindTexture(GL_TEXTURE_2D, clusterGridTexture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, CLUSTER_X * CLUSTER_Y, CLUSTER_Z,
+                 0, GL_RG_INTEGER, GL_UNSIGNED_INT, clusterGrid.data());
+
+    clusterLightListCapacity = 4096;
+    glGenBuffers(1, &clusterLightListBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, clusterLightListBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, clusterLightListCapacity * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+
+    glGenTextures(1, &clusterLightListTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, clusterLightListTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, clusterLightListBuffer);
+
+    lightCapacity = 256;
+    glGenBuffers(1, &lightBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, lightCapacity * 2 * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+
+    glGenTextures(1, &lightTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightBuffer);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void DeferredRenderer::initGeometryShader() {
+    // texture units Scene::drawGeometryPass binds material textures and instance transforms to
+    geometryShader.use();
+    geometryShader.setInt("diffuseTexture", 0);
+    geometryShader.setInt("specularGlossinessTexture", 1);
+    geometryShader.setInt("normalTexture", 2);
+    geometryShader.setInt("occlusionTexture", 3);
+    geometryShader.setInt("emissiveTexture", 4);
+    geometryShader.setInt("instanceTransforms", 5);
+    depthShader.use();
+    depthShader.setInt("instanceTransforms", 5);
+    glUseProgram(0);
+}
+
+void DeferredRenderer::initLightingShader() {
+    static_assert(sizeof(LightingParams) == 160, "LightingParams must match the std140 block size");
+    glGenBuffers(1, &lightingParamsUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, lightingParamsUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightingParams), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // bindings and sampler units never change, so they are set once here instead of every frame
+    glUniformBlockBinding(lightingShader.ID, glGetUniformBlockIndex(lightingShader.ID, "LightingParams"), 0);
+    lightingShader.use();
+    lightingShader.setInt("gDepth", 0);
+    lightingShader.setInt("gNormal", 1);
+    lightingShader.setInt("gAlbedoSpec", 2);
+    lightingShader.setInt("clusterGrid", 3);
+    lightingShader.setInt("clusterLightList", 4);
+    lightingShader.setInt("lightData", 5);
+    lightingShader.setInt("gPosition", 6);
+    glUseProgram(0);
+    setGBufferLayoutUniforms();
+}
+
+void DeferredRenderer::uploadClusterLightList() {
+    PROFILE_ZONE("uploadClusterLightList");
+    glBindTexture(GL_TEXTURE_2D, clusterGridTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, CLUSTER_X * CLUSTER_Y, CLUSTER_Z,
+                    GL_RG_INTEGER, GL_UNSIGNED_INT, clusterGrid.data());
+
+    // only the bytes in use go over the bus; the store grows geometrically and is orphaned on resize
+    glBindBuffer(GL_TEXTURE_BUFFER, clusterLightListBuffer);
+    if (clusterLightList.size() > clusterLightListCapacity) {
+        while (clusterLightListCapacity < clusterLightList.size()) clusterLightListCapacity *= 2;
+        glBufferData(GL_TEXTURE_BUFFER, clusterLightListCapacity * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+    }
+    if (!clusterLightList.empty()) {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, clusterLightList.size() * sizeof(GLuint), clusterLightList.data());
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
 
-    std::vector<int> emptyData(MAX_LIGHTS_PER_CLUSTER * CLUSTER_X * CLUSTER_Y * CLUSTER_Z, -1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I,
-                 MAX_LIGHTS_PER_CLUSTER, CLUSTER_X * CLUSTER_Y * CLUSTER_Z,
-                 0, GL_RED_INTEGER, GL_INT, emptyData.data());
+void DeferredRenderer::uploadLights(const std::vector<Light>& lights) {
+    PROFILE_ZONE("uploadLights");
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+    if (lights.size() > lightCapacity) {
+        while (lightCapacity < lights.size()) lightCapacity *= 2;
+        glBufferData(GL_TEXTURE_BUFFER, lightCapacity * 2 * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+    }
+    if (!lights.empty()) {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, lights.size() * sizeof(Light), lights.data());
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
 }
 
 void DeferredRenderer::geometryPass(const Scene& scene, const Camera& camera) {
+    PROFILE_ZONE("geometryPass");
+    glm::mat4 projection = getProjectionMatrix(camera);
+    glm::mat4 view = camera.GetViewMatrix();
+    cullInstances(scene, projection * view);
+    drawStats = {};
+
     glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
     glViewport(0, 0, screenWidth, screenHeight);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
 
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (depthPrepass) {
+        PROFILE_ZONE("depthPrepass");
+        PassTimer::Scope timing(passTimer, RenderPass::DepthPrepass);
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glDepthFunc(GL_LESS);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
-    glDisable(GL_BLEND);
+        depthShader.use();
+        depthShader.setMat4("projection", projection);
+        depthShader.setMat4("view", view);
+        drawStats += scene.drawDepthPass(depthShader, instanceVisibility);
+
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+
+    PassTimer::Scope timing(passTimer, RenderPass::Geometry);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    if (depthPrepass) {
+        // depth is final already: only the front-most fragment of each pixel passes and is shaded
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    } else {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glDepthFunc(GL_LESS);
+    }
 
     geometryShader.use();
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)screenWidth / screenHeight, 0.1f, 100.0f);
-    glm::mat4 view = camera.GetViewMatrix();
     geometryShader.setMat4("projection", projection);
     geometryShader.setMat4("view", view);
 
-    scene.drawGeometryPass(geometryShader);
+    drawStats += scene.drawGeometryPass(geometryShader, instanceVisibility);
+
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
 
     GLenum err;
     while ((err = glGetError()) != GL_NO_ERROR) {
@@ -136,7 +309,51 @@ void DeferredRenderer::geometryPass(const Scene& scene, const Camera& camera) {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+void DeferredRenderer::cullInstances(const Scene& scene, const glm::mat4& viewProjection) {
+    PROFILE_ZONE("cullInstances");
+    const AABBSoA& bounds = scene.getInstanceBounds();
+    int instanceCount = bounds.size();
+    instanceVisibility.resize((instanceCount + 31) / 32);
+    if (frustumCulling) {
+        instancesDrawn = frustumAABBs(bounds, extractFrustumPlanes(viewProjection), instanceVisibility.data());
+    } else {
+        std::fill(instanceVisibility.begin(), instanceVisibility.end(), ~0u);
+        instancesDrawn = instanceCount;
+    }
+    instancesCulled = instanceCount - instancesDrawn;
+}
+
 void DeferredRenderer::lightingPass(const Scene& scene, const Camera& camera) {
+    PROFILE_ZONE("lightingPass");
+    const auto& lights = scene.getLights();
+    glm::mat4 view = camera.GetViewMatrix();
+
+    {
+        PassTimer::Scope timing(passTimer, RenderPass::ClusterUpload);
+
+        assignLightsToClusters(lights, view);
+        uploadClusterLightList();
+        uploadLights(lights);
+
+        PROFILE_ZONE("lightingParams");
+        LightingParams params{};
+        params.view = view;
+        params.inverseProjection = glm::inverse(getProjectionMatrix(camera));
+        params.screenWidth = screenWidth;
+        params.screenHeight = screenHeight;
+        params.clusterX = CLUSTER_X;
+        params.clusterY = CLUSTER_Y;
+        params.clusterZ = CLUSTER_Z;
+        params.numLights = static_cast<GLint>(lights.size());
+        params.nearPlane = clusterNear;
+        params.farPlane = clusterFar;
+        glBindBuffer(GL_UNIFORM_BUFFER, lightingParamsUBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightingParams), &params);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    PassTimer::Scope timing(passTimer, RenderPass::Lighting);
+
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glViewport(0, 0, screenWidth, screenHeight);
 
@@ -148,50 +365,24 @@ void DeferredRenderer::lightingPass(const Scene& scene, const Camera& camera) {
     glBlendFunc(GL_ONE, GL_ONE);
 
     lightingShader.use();
-    lightingShader.setVec3("viewPos", camera.Position);
-    lightingShader.setMat4("view", camera.GetViewMatrix());
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, lightingParamsUBO);
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
-    lightingShader.setInt("gPosition", 0);
-
+    glBindTexture(GL_TEXTURE_2D, gDepth);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, gNormal);
-    lightingShader.setInt("gNormal", 1);
-
     glActiveTexture(GL_TEXTURE2);
     glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-    lightingShader.setInt("gAlbedoSpec", 2);
-
-    lightingShader.setInt("screenWidth", screenWidth);
-    lightingShader.setInt("screenHeight", screenHeight);
-    lightingShader.setInt("CLUSTER_X", CLUSTER_X);
-    lightingShader.setInt("CLUSTER_Y", CLUSTER_Y);
-    lightingShader.setInt("CLUSTER_Z", CLUSTER_Z);
-    lightingShader.setInt("MAX_LIGHTS_PER_CLUSTER", MAX_LIGHTS_PER_CLUSTER);
-    lightingShader.setFloat("nearPlane", 0.1f);
-    lightingShader.setFloat("farPlane", 100.0f);
-
-    const auto& lights = scene.getLights();
-    int lightCount = std::min<int>(lights.size(), 256);
-    lightingShader.setInt("numLights", lightCount);
-
-    for (int i = 0; i < lightCount; ++i) {
-        const Light& light = lights[i];
-        lightingShader.setVec4("lights[" + std::to_string(i) + "].position_radius",
-                               glm::vec4(light.position, light.radius));
-        lightingShader.setVec3("lights[" + std::to_string(i) + "].color", light.color);
-        lightingShader.setFloat("lights[" + std::to_string(i) + "].intensity", light.intensity);
-    }
-
-    assignLightsToClusters(lights, camera.GetViewMatrix());
-
     glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, clusterLightTexture);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
-                    MAX_LIGHTS_PER_CLUSTER, CLUSTER_X * CLUSTER_Y * CLUSTER_Z,
-                    GL_RED_INTEGER, GL_INT, clusterLightIndices.data());
-    lightingShader.setInt("clusterLightTex", 3);
+    glBindTexture(GL_TEXTURE_2D, clusterGridTexture);
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_BUFFER, clusterLightListTexture);
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+    if (!compactGBuffer) {
+        glActiveTexture(GL_TEXTURE6);
+        glBindTexture(GL_TEXTURE_2D, gPosition);
+    }
 
     renderQuad();
 
@@ -199,6 +390,10 @@ void DeferredRenderer::lightingPass(const Scene& scene, const Camera& camera) {
     glEnable(GL_DEPTH_TEST);
 }
 
+glm::mat4 DeferredRenderer::getProjectionMatrix(const Camera& camera) const {
+    return glm::perspective(glm::radians(camera.Zoom), (float)screenWidth / screenHeight, clusterNear, clusterFar);
+}
+
 void DeferredRenderer::renderQuad() {
     if (quadVAO == 0) {
         float quadVertices[] = {
@@ -232,11 +427,17 @@ void DeferredRenderer::renderQuad() {
 }
 
 void DeferredRenderer::computeClusterBounds(float fov, float aspect, float nearPlane, float farPlane) {
-    clusterAABBs.clear();
-    clusterAABBs.resize(CLUSTER_X * CLUSTER_Y * CLUSTER_Z);
+    clusterBounds.resize(CLUSTER_X * CLUSTER_Y * CLUSTER_Z);
 
-    float tanHalfFovY = tan(glm::radians(fov / 2.0f));
-    float tanHalfFovX = tanHalfFovY * aspect;
+    tanHalfFovY = tan(glm::radians(fov / 2.0f));
+    tanHalfFovX = tanHalfFovY * aspect;
+    clusterNear = nearPlane;
+    clusterFar = farPlane;
+
+    sliceDepths.resize(CLUSTER_Z + 1);
+    for (int z = 0; z <= CLUSTER_Z; ++z) {
+        sliceDepths[z] = nearPlane * std::pow(farPlane / nearPlane, float(z) / CLUSTER_Z);
+    }
 
     for (int z = 0; z < CLUSTER_Z; ++z) {
         float zNear = nearPlane * std::pow(farPlane / nearPlane, float(z) / CLUSTER_Z);
@@ -258,41 +459,142 @@ void DeferredRenderer::computeClusterBounds(float fov, float aspect, float nearP
 
                 int clusterIdx = x + CLUSTER_X * (y + CLUSTER_Y * z);
 
-                clusterAABBs[clusterIdx].min = glm::vec3(
-                        std::min({xNearMin, xNearMax, xFarMin, xFarMax}),
-                        std::min({yNearMin, yNearMax, yFarMin, yFarMax}),
-                        -zFar  // Negative because view space Z points toward viewer
-                );
-                clusterAABBs[clusterIdx].max = glm::vec3(
-                        std::max({xNearMin, xNearMax, xFarMin, xFarMax}),
-                        std::max({yNearMin, yNearMax, yFarMin, yFarMax}),
-                        -zNear
-                );
+                clusterBounds.set(clusterIdx,
+                        glm::vec3(
+                                std::min({xNearMin, xNearMax, xFarMin, xFarMax}),
+                                std::min({yNearMin, yNearMax, yFarMin, yFarMax}),
+                                -zFar  // Negative because view space Z points toward viewer
+                        ),
+                        glm::vec3(
+                                std::max({xNearMin, xNearMax, xFarMin, xFarMax}),
+                                std::max({yNearMin, yNearMax, yFarMin, yFarMax}),
+                                -zNear
+                        ));
             }
         }
     }
 }
 
 void DeferredRenderer::assignLightsToClusters(const std::vector<Light>& lights, const glm::mat4& viewMatrix) {
-    std::fill(clusterLightCounts.begin(), clusterLightCounts.end(), 0);
-    std::fill(clusterLightIndices.begin(), clusterLightIndices.end(), -1);
+    PROFILE_ZONE("assignLightsToClusters");
+    int lightCount = static_cast<int>(lights.size());
+
+    lightViewPositions.resize(lightCount);
+    for (int lightIdx = 0; lightIdx < lightCount; ++lightIdx) {
+        lightViewPositions[lightIdx] = glm::vec3(viewMatrix * glm::vec4(lights[lightIdx].position, 1.0f));
+    }
+
+    // Each task owns a contiguous run of Z slices and writes its clusters' lists into its own scratch
+    // buffer. Concatenating the scratch buffers in task order yields the lists in cluster order, so the
+    // result is identical to the serial path no matter how many threads ran.
+    int taskCount = assignmentPool ? std::min(assignmentThreadCount, CLUSTER_Z) : 1;
+    if (assignmentScratch.size() < static_cast<size_t>(taskCount)) assignmentScratch.resize(taskCount);
+
+    auto runTask = [&](int task) {
+        int zBegin = CLUSTER_Z * task / taskCount;
+        int zEnd = CLUSTER_Z * (task + 1) / taskCount;
+        assignLightsToSlices(lights, lightCount, zBegin, zEnd, assignmentScratch[task]);
+    };
+    if (assignmentPool) {
+        assignmentPool->parallelFor(taskCount, runTask);
+    } else {
+        runTask(0);
+    }
+
+    const int clustersPerSlice = CLUSTER_X * CLUSTER_Y;
+    size_t total = 0;
+    for (int task = 0; task < taskCount; ++task) total += assignmentScratch[task].lightIndices.size();
+    clusterLightList.resize(total);
 
-    for (int lightIdx = 0; lightIdx < lights.size() && lightIdx < 256; ++lightIdx) {
-        const Light& light = lights[lightIdx];
-        glm::vec3 lightViewPos = glm::vec3(viewMatrix * glm::vec4(light.position, 1.0f));
+    GLuint base = 0;
+    for (int task = 0; task < taskCount; ++task) {
+        const std::vector<GLuint>& indices = assignmentScratch[task].lightIndices;
+        std::copy(indices.begin(), indices.end(), clusterLightList.begin() + base);
 
-        for (int clusterIdx = 0; clusterIdx < clusterAABBs.size(); ++clusterIdx) {
-            const ClusterAABB& aabb = clusterAABBs[clusterIdx];
+        int clusterBegin = CLUSTER_Z * task / taskCount * clustersPerSlice;
+        int clusterEnd = CLUSTER_Z * (task + 1) / taskCount * clustersPerSlice;
+        for (int clusterIdx = clusterBegin; clusterIdx < clusterEnd; ++clusterIdx) {
+            clusterGrid[clusterIdx].x += base;
+        }
+        base += static_cast<GLuint>(indices.size());
+    }
+}
 
-            if (sphereIntersectsAABB(lightViewPos, light.radius, aabb.min, aabb.max)) {
-                int count = clusterLightCounts[clusterIdx];
-                if (count < MAX_LIGHTS_PER_CLUSTER) {
-                    clusterLightIndices[clusterIdx * MAX_LIGHTS_PER_CLUSTER + count] = lightIdx;
-                    clusterLightCounts[clusterIdx]++;
+void DeferredRenderer::assignLightsToSlices(const std::vector<Light>& lights, int lightCount, int zBegin, int zEnd,
+                                            AssignmentScratch& scratch) {
+    PROFILE_ZONE("assignLightsToSlices");
+    static_assert(CLUSTER_X <= 32, "a cluster row has to fit in one kernel hit mask");
+
+    const int clustersPerSlice = CLUSTER_X * CLUSTER_Y;
+    const int clusterBegin = zBegin * clustersPerSlice;
+    const int clusterEnd = zEnd * clustersPerSlice;
+
+    const float logDepthRatio = std::log(clusterFar / clusterNear);
+    auto sliceOf = [&](float depth) {
+        return int(std::floor(std::log(std::max(depth, clusterNear) / clusterNear) / logDepthRatio * CLUSTER_Z));
+    };
+
+    scratch.hits.clear();
+    for (int lightIdx = 0; lightIdx < lightCount; ++lightIdx) {
+        const glm::vec3& lightViewPos = lightViewPositions[lightIdx];
+        float radius = lights[lightIdx].radius;
+
+        // view space looks down -Z, slices are laid out logarithmically in positive distance
+        float depth = -lightViewPos.z;
+        int zFirst = std::max(sliceOf(depth - radius) - 1, zBegin);
+        int zLast = std::min(sliceOf(depth + radius) + 1, zEnd - 1);
+
+        for (int z = zFirst; z <= zLast; ++z) {
+            int xFirst, xLast, yFirst, yLast;
+            tileRange(lightViewPos.x, radius, tanHalfFovX, sliceDepths[z], sliceDepths[z + 1], CLUSTER_X, xFirst, xLast);
+            tileRange(lightViewPos.y, radius, tanHalfFovY, sliceDepths[z], sliceDepths[z + 1], CLUSTER_Y, yFirst, yLast);
+
+            for (int y = yFirst; y <= yLast; ++y) {
+                // clusters along X are contiguous, so a whole row span is one kernel call
+                int rowStart = xFirst + CLUSTER_X * (y + CLUSTER_Y * z);
+                uint32_t hits = sphereClusters(clusterBounds, rowStart, xLast - xFirst + 1, lightViewPos, radius);
+
+                while (hits) {
+                    scratch.hits.emplace_back(rowStart + std::countr_zero(hits), lightIdx);
+                    hits &= hits - 1;
                 }
             }
         }
     }
+
+    // stable counting sort by cluster: each cluster's lights stay in ascending order
+    for (int clusterIdx = clusterBegin; clusterIdx < clusterEnd; ++clusterIdx) {
+        clusterGrid[clusterIdx] = glm::uvec2(0);
+    }
+    for (const glm::uvec2& hit : scratch.hits) {
+        clusterGrid[hit.x].y++;
+    }
+    GLuint offset = 0;
+    for (int clusterIdx = clusterBegin; clusterIdx < clusterEnd; ++clusterIdx) {
+        clusterGrid[clusterIdx].x = offset;
+        offset += clusterGrid[clusterIdx].y;
+    }
+
+    scratch.lightIndices.resize(scratch.hits.size());
+    for (const glm::uvec2& hit : scratch.hits) {
+        // x doubles as the write cursor here and is rewound below
+        scratch.lightIndices[clusterGrid[hit.x].x++] = hit.y;
+    }
+    for (int clusterIdx = clusterBegin; clusterIdx < clusterEnd; ++clusterIdx) {
+        clusterGrid[clusterIdx].x -= clusterGrid[clusterIdx].y;
+    }
+}
+
+void DeferredRenderer::setAssignmentThreadCount(int count) {
+    count = std::clamp(count, 1, CLUSTER_Z);
+    if (count == assignmentThreadCount) return;
+
+    assignmentThreadCount = count;
+    // the calling thread takes part in parallelFor, so the pool only needs count - 1 workers
+    assignmentPool.reset();
+    if (count > 1) {
+        assignmentPool = std::make_unique<ThreadPool>(count - 1);
+    }
 }
 
 int DeferredRenderer::getWidth() {
@@ -309,6 +611,7 @@ void DeferredRenderer::setScreenSize(int width, int height, const Camera& camera
     screenWidth = width;
     screenHeight = height;
 
+    deleteGBuffer();
     initGBuffer();
 
     float nearPlane = 0.1f;
@@ -9,11 +9,10 @@
 #include "shader.h"
 #include "Scene.h"
 #include "camera.h"
-
-struct ClusterAABB {
-    glm::vec3 min;
-    glm::vec3 max;
-};
+#include "ThreadPool.h"
+#include "ClusterCulling.h"
+#include "PassTimer.h"
+#include <memory>
 
 class DeferredRenderer {
 public:
@@ -28,32 +27,113 @@ public:
 
     void setScreenSize(int width, int height, const Camera& camera);
 
+    // number of threads used for light assignment; 1 runs the serial path
+    void setAssignmentThreadCount(int count);
+    int getAssignmentThreadCount() const { return assignmentThreadCount; }
+    const char* getCullingKernelName() const { return ::getCullingKernelName(cullingKernel); }
+
+    // lays down depth with a position-only shader first, so the G-buffer pass shades each pixel once
+    void setDepthPrepass(bool enabled) { depthPrepass = enabled; }
+    bool isDepthPrepassEnabled() const { return depthPrepass; }
+
+    // Compact G-buffer (12 bytes/pixel): position rebuilt from depth, octahedral RG16 normals. Off
+    // restores the wide layout with RGB16F position and normal targets (20 bytes/pixel), for A/B runs.
+    void setCompactGBuffer(bool enabled);
+    bool isCompactGBufferEnabled() const { return compactGBuffer; }
+
+    // skips instances whose bounds are outside the view frustum; off draws everything
+    void setFrustumCulling(bool enabled) { frustumCulling = enabled; }
+    bool isFrustumCullingEnabled() const { return frustumCulling; }
+    int getInstancesDrawn() const { return instancesDrawn; }
+    int getInstancesCulled() const { return instancesCulled; }
+    // draws and binds issued by the last geometry pass (and depth pre-pass)
+    const DrawStats& getDrawStats() const { return drawStats; }
+
+    PassTimer& getPassTimer() { return passTimer; }
+
 private:
     void initGBuffer();
+    void deleteGBuffer();
+    void initClusterBuffers();
+    void initGeometryShader();
+    void initLightingShader();
+    // tells both G-buffer shaders which layout is attached
+    void setGBufferLayoutUniforms();
+    void uploadClusterLightList();
+    void uploadLights(const std::vector<Light>& lights);
 
     GLuint gBuffer;
-    GLuint gPosition, gNormal, gAlbedoSpec;
-    GLuint rboDepth;
-    GLuint clusterLightTexture;
+    GLuint gNormal;     // RG16 octahedral-encoded (compact) or RGB16F raw view-space normal
+    GLuint gPosition = 0; // RGB16F view-space position, wide layout only
+    GLuint gAlbedoSpec; // RGBA8 albedo + specular strength
+    GLuint gDepth;      // 24-bit depth, sampled to reconstruct view-space position
+    GLuint clusterGridTexture;      // RG32UI (offset, count) per cluster
+    GLuint clusterLightListBuffer;  // packed light indices, read through clusterLightListTexture
+    GLuint clusterLightListTexture;
+    size_t clusterLightListCapacity = 0;
+    GLuint lightBuffer;             // two RGBA32F texels per light, read through lightTexture
+    GLuint lightTexture;
+    size_t lightCapacity = 0;
+    GLuint lightingParamsUBO;
 
+    // std140 mirror of the LightingParams block in lighting.frag
+    struct LightingParams {
+        glm::mat4 view;
+        glm::mat4 inverseProjection;
+        GLint screenWidth, screenHeight;
+        GLint clusterX, clusterY, clusterZ;
+        GLint numLights;
+        GLfloat nearPlane, farPlane;
+    };
+
+    int screenWidth, screenHeight;
+    Shader depthShader;
     Shader geometryShader;
     Shader lightingShader;
+    PassTimer passTimer;
 
-    int screenWidth, screenHeight;
+    bool depthPrepass = false;
+    bool compactGBuffer = true;
+    bool frustumCulling = true;
+    std::vector<uint32_t> instanceVisibility; // one bit per scene instance, rebuilt every geometry pass
+    int instancesDrawn = 0, instancesCulled = 0;
+    DrawStats drawStats;
     GLuint quadVAO = 0, quadVBO = 0;
 
-    static const int CLUSTER_X = 16;
-    static const int CLUSTER_Y = 9;
-    static const int CLUSTER_Z = 24;
-    static const int MAX_LIGHTS_PER_CLUSTER = 100;
+    static constexpr int CLUSTER_X = 16;
+    static constexpr int CLUSTER_Y = 9;
+    static constexpr int CLUSTER_Z = 24;
+
+    // per-thread output of one assignment task: its clusters' light indices, back to back
+    struct AssignmentScratch {
+        std::vector<glm::uvec2> hits; // (cluster, light) in light order
+        std::vector<GLuint> lightIndices;
+    };
+
+    std::vector<glm::uvec2> clusterGrid;    // (offset into clusterLightList, count) per cluster
+    std::vector<GLuint> clusterLightList;   // every cluster's light indices, packed in cluster order
+    std::vector<AssignmentScratch> assignmentScratch;
+    AABBSoA clusterBounds;
+    CullingKernelType cullingKernel = detectCullingKernel();
+    SphereClustersKernel sphereClusters = getSphereClustersKernel(cullingKernel);
+    FrustumAABBsKernel frustumAABBs = getFrustumAABBsKernel(cullingKernel);
+    std::vector<glm::vec3> lightViewPositions;
+
+    // frustum parameters the cluster grid was last built with, used to bin lights by range
+    float clusterNear = 0.1f, clusterFar = 100.0f;
+    float tanHalfFovX = 0.0f, tanHalfFovY = 0.0f;
+    std::vector<float> sliceDepths; // CLUSTER_Z + 1 slice boundaries, positive view distance
 
-    std::vector<int> clusterLightCounts;
-    std::vector<int> clusterLightIndices; // flattened: CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER
-    std::vector<ClusterAABB> clusterAABBs;
+    int assignmentThreadCount = 1;
+    std::unique_ptr<ThreadPool> assignmentPool;
 
     void renderQuad();
+    void cullInstances(const Scene& scene, const glm::mat4& viewProjection);
+    glm::mat4 getProjectionMatrix(const Camera& camera) const;
     void computeClusterBounds(float fov, float aspect, float nearPlane, float farPlane);
     void assignLightsToClusters(const std::vector<Light>& lights, const glm::mat4& viewMatrix);
+    void assignLightsToSlices(const std::vector<Light>& lights, int lightCount, int zBegin, int zEnd,
+                              AssignmentScratch& scratch);
 };
 
 #endif //CLUSTEREDDEFERREDRENDERER_DEFERREDRENDERER_H
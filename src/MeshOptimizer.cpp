@@ -0,0 +1,251 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace {
+
+// cache model and weights from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+constexpr int FORSYTH_CACHE_SIZE = 32;
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+float vertexScore(int cachePosition, uint32_t remainingTriangles) {
+    if (remainingTriangles == 0) return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // the three vertices of the last triangle get a fixed score so it is not immediately reused
+        if (cachePosition < 3) {
+            score = LAST_TRIANGLE_SCORE;
+        } else {
+            float scaler = 1.0f / float(FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - float(cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+        }
+    }
+    // favour vertices with few triangles left so they do not end up as lone stragglers
+    return score + VALENCE_BOOST_SCALE * std::pow(float(remainingTriangles), -VALENCE_BOOST_POWER);
+}
+
+bool indicesInRange(const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    for (size_t i = 0; i < indexCount; ++i) {
+        if (indices[i] >= vertexCount) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+float computeACMR(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || !indicesInRange(indices, indexCount, vertexCount)) return 0.0f;
+
+    // a vertex is cached while fewer than cacheSize misses happened since it was last loaded
+    std::vector<size_t> loadedAt(vertexCount, 0);
+    size_t misses = 0;
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        uint32_t v = indices[i];
+        if (loadedAt[v] == 0 || misses + 1 - loadedAt[v] > cacheSize) {
+            ++misses;
+            loadedAt[v] = misses;
+        }
+    }
+    return float(misses) / float(triangleCount);
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2 || !indicesInRange(indices, indexCount, vertexCount)) return;
+
+    // vertex -> triangles that still have to be emitted; the live ones are kept in the first
+    // remaining[v] slots of the vertex's range
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) remaining[indices[i]]++;
+    std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i) adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) vertexScores[v] = vertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] +
+                            vertexScores[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+    size_t cacheCount = 0;
+
+    auto best = static_cast<int64_t>(std::max_element(triangleScores.begin(), triangleScores.end()) -
+                                     triangleScores.begin());
+    size_t scanCursor = 0;
+
+    while (output.size() < triangleCount * 3) {
+        if (best < 0) {
+            // nothing in the cache touches a live triangle: continue with the next unemitted one
+            while (emitted[scanCursor]) ++scanCursor;
+            best = static_cast<int64_t>(scanCursor);
+        }
+
+        const uint32_t* triangle = indices + best * 3;
+        emitted[best] = true;
+        output.insert(output.end(), triangle, triangle + 3);
+
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = triangle[k];
+            uint32_t* list = adjacency.data() + adjacencyOffset[v];
+            uint32_t* last = list + remaining[v] - 1;
+            std::iter_swap(std::find(list, last + 1, uint32_t(best)), last);
+            remaining[v]--;
+        }
+
+        // the triangle's vertices move to the front, everything else shifts back
+        size_t newCount = 0;
+        for (int k = 0; k < 3; ++k) newCache[newCount++] = triangle[k];
+        for (size_t i = 0; i < cacheCount; ++i) {
+            uint32_t v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) newCache[newCount++] = v;
+        }
+
+        // rescore every vertex that moved, including the ones that just fell out of the cache
+        for (size_t i = 0; i < newCount; ++i) {
+            uint32_t v = newCache[i];
+            int position = i < FORSYTH_CACHE_SIZE ? int(i) : -1;
+            cachePosition[v] = position;
+            float score = vertexScore(position, remaining[v]);
+            float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+            const uint32_t* list = adjacency.data() + adjacencyOffset[v];
+            for (uint32_t j = 0; j < remaining[v]; ++j) triangleScores[list[j]] += delta;
+        }
+
+        cacheCount = std::min<size_t>(newCount, FORSYTH_CACHE_SIZE);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        // the next triangle is the best one reachable from the cache
+        best = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < cacheCount; ++i) {
+            uint32_t v = cache[i];
+            const uint32_t* list = adjacency.data() + adjacencyOffset[v];
+            for (uint32_t j = 0; j < remaining[v]; ++j) {
+                if (triangleScores[list[j]] > bestScore) {
+                    bestScore = triangleScores[list[j]];
+                    best = list[j];
+                }
+            }
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount,
+                      size_t positionStride) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2 || !indicesInRange(indices, indexCount, vertexCount)) return;
+
+    // a triangle that misses the cache on all three vertices starts a new cluster; reordering
+    // clusters then costs little ACMR. Tiny clusters are merged to keep the sort meaningful.
+    constexpr unsigned CACHE_SIZE = 16;
+    constexpr size_t MIN_CLUSTER_TRIANGLES = 32;
+    std::vector<size_t> clusterStarts{0};
+    {
+        std::vector<size_t> loadedAt(vertexCount, 0);
+        size_t misses = 0;
+        for (size_t t = 0; t < triangleCount; ++t) {
+            int triangleMisses = 0;
+            for (int k = 0; k < 3; ++k) {
+                uint32_t v = indices[t * 3 + k];
+                if (loadedAt[v] == 0 || misses + 1 - loadedAt[v] > CACHE_SIZE) {
+                    ++misses;
+                    loadedAt[v] = misses;
+                    ++triangleMisses;
+                }
+            }
+            if (triangleMisses == 3 && t - clusterStarts.back() >= MIN_CLUSTER_TRIANGLES) clusterStarts.push_back(t);
+        }
+    }
+    if (clusterStarts.size() < 2) return;
+    clusterStarts.push_back(triangleCount);
+
+    auto position = [&](uint32_t v) {
+        const float* p = positions + size_t(v) * positionStride;
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    glm::vec3 meshCentroid(0.0f);
+    for (size_t v = 0; v < vertexCount; ++v) meshCentroid += position(uint32_t(v));
+    meshCentroid /= float(vertexCount);
+
+    // sort key: how far the cluster faces away from the mesh centre
+    size_t clusterCount = clusterStarts.size() - 1;
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+            glm::vec3 p0 = position(indices[t * 3]);
+            glm::vec3 p1 = position(indices[t * 3 + 1]);
+            glm::vec3 p2 = position(indices[t * 3 + 2]);
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);   // length is twice the area
+            float triangleArea = glm::length(n);
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += n;
+            area += triangleArea;
+        }
+        if (area > 0.0f) centroid /= area;
+        float normalLength = glm::length(normal);
+        sortKeys[c] = normalLength > 0.0f ? glm::dot(centroid - meshCentroid, normal / normalLength) : 0.0f;
+    }
+
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    for (size_t c : order) {
+        output.insert(output.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeVertexFetch(float* vertices, size_t vertexCount, size_t vertexStride, uint32_t* indices,
+                         size_t indexCount) {
+    if (!indicesInRange(indices, indexCount, vertexCount)) return;
+
+    constexpr uint32_t UNUSED = ~0u;
+    std::vector<uint32_t> remap(vertexCount, UNUSED);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t& target = remap[indices[i]];
+        if (target == UNUSED) target = next++;
+        indices[i] = target;
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (remap[v] == UNUSED) remap[v] = next++;
+    }
+
+    std::vector<float> reordered(vertexCount * vertexStride);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        std::copy(vertices + v * vertexStride, vertices + (v + 1) * vertexStride,
+                  reordered.begin() + size_t(remap[v]) * vertexStride);
+    }
+    std::copy(reordered.begin(), reordered.end(), vertices);
+}
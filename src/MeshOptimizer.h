@@ -0,0 +1,28 @@
+#ifndef CLUSTEREDDEFERREDRENDERER_MESHOPTIMIZER_H
+#define CLUSTEREDDEFERREDRENDERER_MESHOPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Load-time reordering of indexed triangle lists. Every function works on one primitive: indices
+// are relative to its first vertex and index into vertexCount vertices.
+
+// average post-transform cache misses per triangle for a FIFO cache of cacheSize entries
+// (lower is better; ~0.5 is the lower bound for regular meshes, 3.0 means no reuse at all)
+float computeACMR(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = 16);
+
+// Tom Forsyth's linear-speed vertex cache optimisation; reorders triangles in place
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Splits an already cache-optimised list into clusters at points where the cache restarts anyway
+// and emits outward-facing clusters first, so the front of the mesh tends to win the depth test
+// before the back is shaded. positions are xyz floats, positionStride floats apart.
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount,
+                      size_t positionStride);
+
+// renumbers vertices in order of first use so vertex fetch walks the buffer linearly;
+// vertices are vertexStride floats each, unreferenced ones move to the end
+void optimizeVertexFetch(float* vertices, size_t vertexCount, size_t vertexStride, uint32_t* indices,
+                         size_t indexCount);
+
+#endif //CLUSTEREDDEFERREDRENDERER_MESHOPTIMIZER_H
@@ -5,45 +5,283 @@
 #include "cgltf.h"
 
 #include "ModelLoader.h"
+#include "ClusterCulling.h"
+#include "MeshOptimizer.h"
+#include "TextureBaker.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
 #include <unordered_map>
+#include <mutex>
 #include <limits>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/packing.hpp>
+
+// S3TC (BC1/BC3) and its sRGB variants are extensions the glad loader was generated without;
+// RGTC (BC4/BC5) is core since 3.0
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+namespace {
+
+// assigning {} to a container keeps its capacity; swapping with a fresh one actually frees it
+template <typename Container>
+void releaseMemory(Container& container) {
+    Container().swap(container);
+}
+
+// shared by every load for geometry and image decoding; the calling thread takes part in parallelFor,
+// hence one worker fewer than cores
+ThreadPool& getLoaderPool() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+// Textures outlive the models that loaded them and are shared by path across loads. prepare()
+// consults the cache off the GL thread to skip decoding, upload() fills it.
+std::mutex textureCacheMutex;
+std::unordered_map<std::string, GLuint> textureCache;
+
+GLuint findCachedTexture(const std::string& key) {
+    std::lock_guard<std::mutex> lock(textureCacheMutex);
+    auto it = textureCache.find(key);
+    return it != textureCache.end() ? it->second : 0;
+}
 
+GLenum getTextureInternalFormat(TextureFormat format, bool srgb) {
+    switch (format) {
+        case TextureFormat::RGBA8: return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA;
+        case TextureFormat::BC1: return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TextureFormat::BC3:
+            return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case TextureFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+        case TextureFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+    }
+    return GL_RGBA;
+}
+
+// bytes the chain would take as RGBA8, to report what compression saved
+size_t getUncompressedBytes(const std::vector<TextureLevel>& levels) {
+    size_t bytes = 0;
+    for (const TextureLevel& level : levels) {
+        bytes += getTextureLevelBytes(TextureFormat::RGBA8, level.width, level.height);
+    }
+    return bytes;
+}
+
+} // namespace
+
+const char* getModelLoadStageName(ModelLoadStage stage) {
+    switch (stage) {
+        case ModelLoadStage::Idle: return "idle";
+        case ModelLoadStage::Parsing: return "parsing";
+        case ModelLoadStage::DecodingTextures: return "decoding textures";
+        case ModelLoadStage::DecodingGeometry: return "decoding geometry";
+        case ModelLoadStage::Optimizing: return "optimizing";
+        case ModelLoadStage::Uploading: return "uploading";
+        case ModelLoadStage::Done: return "done";
+        case ModelLoadStage::Failed: return "failed";
+    }
+    return "";
+}
+
+void ModelLoader::setStage(ModelLoadStage next, size_t total) {
+    stageDone = 0;
+    stageTotal = total;
+    stage = next;
+}
+
+ModelLoadProgress ModelLoader::getProgress() const {
+    size_t total = stageTotal;
+    float fraction = total > 0 ? std::min(1.0f, float(stageDone) / float(total)) : 0.0f;
+    return { stage, fraction };
+}
+
+int ModelLoader::addTexture(const std::string& path) {
+    auto known = textureSlots.find(path);
+    if (known != textureSlots.end()) return known->second;
+
+    PendingTexture texture;
+    texture.path = path;
+    // Use sRGB format for diffuse textures (base color)
+    // Check if this is a diffuse/base color texture by filename
+    texture.srgb = path.find("baseColor") != std::string::npos ||
+                   path.find("diffuse") != std::string::npos ||
+                   path.find("albedo") != std::string::npos;
+    texture.id = findCachedTexture(getTextureKey(path));
+    textures.push_back(std::move(texture));
+    textureSlots[path] = static_cast<int>(textures.size() - 1);
+    return static_cast<int>(textures.size() - 1);
+}
+
+std::string ModelLoader::getTextureKey(const std::string& path) const {
+    return compressTextures ? path + "#bc" : path;
+}
+
+void ModelLoader::assignTextureUsages() {
+    // slot order as in meshTextureSlots; an image shared between slots of different usage keeps every channel
+    static constexpr TextureUsage slotUsages[5] = { TextureUsage::Color, TextureUsage::Color, TextureUsage::Normal,
+                                                    TextureUsage::Mask, TextureUsage::Color };
+    std::vector<bool> assigned(textures.size(), false);
+    for (const std::array<int, 5>& slots : meshTextureSlots) {
+        for (size_t s = 0; s < slots.size(); ++s) {
+            if (slots[s] < 0) continue;
+            PendingTexture& texture = textures[slots[s]];
+            if (!assigned[slots[s]]) {
+                texture.usage = slotUsages[s];
+                assigned[slots[s]] = true;
+            } else if (texture.usage != slotUsages[s]) {
+                texture.usage = TextureUsage::Color;
+            }
+        }
+    }
+}
+
+void ModelLoader::decodeTextures() {
+    PROFILE_ZONE("ModelLoader::decodeTextures");
+    assignTextureUsages();
+    setStage(ModelLoadStage::DecodingTextures, textures.size());
+    // PNG inflate dominates cold loads; every image decodes independently on the loader pool
+    getLoaderPool().parallelFor(static_cast<int>(textures.size()), [&](int t) {
+        if (textures[t].id == 0) decodeTexture(textures[t]);
+        ++stageDone;
+    });
+
+    if (useTextureCache) {
+        size_t lookups = 0, hits = 0;
+        for (const PendingTexture& texture : textures) {
+            lookups += texture.id == 0;
+            hits += texture.cacheHit;
+        }
+        if (lookups > 0) {
+            std::cout << "Texture cache: " << hits << " of " << lookups << " hits ("
+                      << 100.0 * double(hits) / double(lookups) << "%)\n";
+        }
+    }
+
+    if (compressTextures) {
+        size_t compressed = 0, uncompressedBytes = 0, compressedBytes = 0;
+        for (const PendingTexture& texture : textures) {
+            if (texture.levels.empty()) continue;
+            ++compressed;
+            uncompressedBytes += getUncompressedBytes(texture.levels);
+            for (const TextureLevel& level : texture.levels) compressedBytes += level.data.size();
+        }
+        if (compressed > 0) {
+            std::cout << "Texture compression: " << compressed << " textures take " << compressedBytes / (1024 * 1024)
+                      << " MiB instead of " << uncompressedBytes / (1024 * 1024) << " MiB ("
+                      << (uncompressedBytes - compressedBytes) / (1024 * 1024) << " MiB saved)\n";
+        }
+    }
+}
+
+void ModelLoader::decodeTexture(PendingTexture& texture) {
+    PROFILE_ZONE("ModelLoader::decodeTexture");
+    if (useTextureCache) {
+        auto file = std::make_unique<MappedFile>();
+        TextureFormat format;
+        if (readTextureCache(texture.path, *file, format, texture.levels)) {
+            // a cache baked with the other compression setting is rebuilt and overwritten
+            bool wanted = compressTextures ? isCompressedFormatFor(format, texture.usage, texture.srgb)
+                                           : format == TextureFormat::RGBA8;
+            if (wanted) {
+                texture.format = format;
+                texture.cacheFile = std::move(file);
+                texture.cacheHit = true;
+                return;
+            }
+            texture.levels.clear();
+        }
+    }
 
-GLuint ModelLoader::loadTextureFromFile(const std::string& path) {
     int width, height, channels;
-    unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    unsigned char* data = stbi_load(texture.path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
     if (!data) {
-        std::cerr << "Failed to load texture: " << path << "\n";
-        return 0;
+        // runs on pool threads: one insertion per message keeps concurrent lines whole without a lock
+        std::cerr << "Failed to load texture: " + texture.path + "\n";
+        return;
     }
+    // mips are built here rather than with glGenerateMipmap so the cache can hold them
+    buildMipChain(data, uint32_t(width), uint32_t(height), texture.srgb, texture.pixels, texture.levels);
+    stbi_image_free(data);
+    if (compressTextures) {
+        // the blocks are encoded from the finished RGBA8 chain, which is dropped afterwards
+        std::vector<uint8_t> blocks;
+        std::vector<TextureLevel> compressed;
+        texture.format = chooseCompressedFormat(texture.levels[0], texture.usage, texture.srgb);
+        compressMipChain(texture.levels, texture.format, getLoaderPool(), blocks, compressed);
+        texture.pixels.swap(blocks);
+        texture.levels.swap(compressed);
+    }
+    if (useTextureCache) writeTextureCache(texture.path, texture.format, texture.levels);
+}
+
+GLuint ModelLoader::uploadTexture(PendingTexture& texture) {
+    if (texture.id != 0) return texture.id;
+    // a texture that failed to decode stays 0, as do later references to it
+    if (texture.levels.empty()) return 0;
+
+    // an earlier load may have uploaded it while this one was being prepared
+    texture.id = findCachedTexture(getTextureKey(texture.path));
+    if (texture.id != 0) return texture.id;
 
     GLuint texID;
     glGenTextures(1, &texID);
     glBindTexture(GL_TEXTURE_2D, texID);
-    
-    // Use sRGB format for diffuse textures (base color)
-    // Check if this is a diffuse/base color texture by filename
-    bool isDiffuse = path.find("baseColor") != std::string::npos || 
-                     path.find("diffuse") != std::string::npos ||
-                     path.find("albedo") != std::string::npos;
-    
-    GLint internalFormat = isDiffuse ? GL_SRGB8_ALPHA8 : GL_RGBA;
-    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+
+    GLenum internalFormat = getTextureInternalFormat(texture.format, texture.srgb);
+    for (size_t level = 0; level < texture.levels.size(); ++level) {
+        const TextureLevel& mip = texture.levels[level];
+        if (texture.format == TextureFormat::RGBA8) {
+            glTexImage2D(GL_TEXTURE_2D, GLint(level), GLint(internalFormat), GLsizei(mip.width), GLsizei(mip.height), 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, mip.data.data());
+        } else {
+            glCompressedTexImage2D(GL_TEXTURE_2D, GLint(level), internalFormat, GLsizei(mip.width),
+                                   GLsizei(mip.height), 0, GLsizei(mip.data.size()), mip.data.data());
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(texture.levels.size() - 1));
+    if (texture.format == TextureFormat::BC4) {
+        // one channel reads back as grey, like the RGBA8 image it came from
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+    } else if (texture.format == TextureFormat::BC5) {
+        // alpha 0 tells geometry.frag to rebuild z from x and y
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ZERO);
+    }
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glBindTexture(GL_TEXTURE_2D, 0);
-    stbi_image_free(data);
+    texture.levels.clear();
+    releaseMemory(texture.pixels);
+    texture.cacheFile.reset();
+
+    texture.id = texID;
+    std::lock_guard<std::mutex> lock(textureCacheMutex);
+    textureCache[getTextureKey(texture.path)] = texID;
     return texID;
 }
 
@@ -69,8 +307,6 @@ glm::mat4 ModelLoader::getNodeTransform(cgltf_node* node) {
 
 void ModelLoader::processNode(cgltf_node* node, const glm::mat4& parentTransform, const std::string& directory,
                               std::vector<Mesh>& meshes, const cgltf_data* data) {
-    static std::unordered_map<std::string, GLuint> textureCache;  // Caches texture loads
-
     glm::mat4 localTransform = getNodeTransform(node);
     glm::mat4 transform = parentTransform * localTransform;
 
@@ -78,123 +314,71 @@ void ModelLoader::processNode(cgltf_node* node, const glm::mat4& parentTransform
         for (cgltf_size p = 0; p < node->mesh->primitives_count; ++p) {
             cgltf_primitive* prim = &node->mesh->primitives[p];
 
-            cgltf_accessor* posAccessor = nullptr;
-            cgltf_accessor* normAccessor = nullptr;
-            cgltf_accessor* uvAccessor = nullptr;
-            cgltf_accessor* tangentAccessor = nullptr;
+            auto known = primitiveMeshes.find(prim);
+            if (known != primitiveMeshes.end()) {
+                meshInstances[known->second].push_back(transform);
+                continue;
+            }
 
+            PrimitiveSource source;
             for (cgltf_size i = 0; i < prim->attributes_count; ++i) {
                 cgltf_attribute* attr = &prim->attributes[i];
-                if (strcmp(attr->name, "POSITION") == 0) posAccessor = attr->data;
-                if (strcmp(attr->name, "NORMAL") == 0) normAccessor = attr->data;
-                if (strcmp(attr->name, "TEXCOORD_0") == 0) uvAccessor = attr->data;
-                if (strcmp(attr->name, "TANGENT") == 0) tangentAccessor = attr->data;
+                if (strcmp(attr->name, "POSITION") == 0) source.position = attr->data;
+                if (strcmp(attr->name, "NORMAL") == 0) source.normal = attr->data;
+                if (strcmp(attr->name, "TEXCOORD_0") == 0) source.uv = attr->data;
+                if (strcmp(attr->name, "TANGENT") == 0) source.tangent = attr->data;
             }
+            source.indices = prim->indices;
 
-            if (!posAccessor) {
+            if (!source.position) {
                 std::cerr << "Missing POSITION accessor. Skipping primitive.\n";
                 continue;
             }
 
-            size_t count = posAccessor->count;
-            std::vector<float> vertices(count * 12);  // 3 + 3 + 2 + 4 floats per vertex
-
-            for (size_t i = 0; i < count; ++i) {
-                float pos[3], norm[3] = {0}, uv[2] = {0}, tangent[4] = {0,0,0,1};
-                cgltf_accessor_read_float(posAccessor, i, pos, 3);
-                if (normAccessor) cgltf_accessor_read_float(normAccessor, i, norm, 3);
-                if (uvAccessor) cgltf_accessor_read_float(uvAccessor, i, uv, 2);
-                if (tangentAccessor) cgltf_accessor_read_float(tangentAccessor, i, tangent, 4);
-
-                // Store vertices in model space (let Scene handle all transformations)
-                glm::vec3 modelPos = glm::vec3(pos[0], pos[1], pos[2]);
-                glm::vec3 modelNormal = glm::vec3(norm[0], norm[1], norm[2]);
-                glm::vec3 modelTangent = glm::vec3(tangent[0], tangent[1], tangent[2]);
-
-                // Update bounds in world space so normalization accounts for node transforms
-                glm::vec3 worldPos = glm::vec3(transform * glm::vec4(modelPos, 1.0f));
-                minBounds = glm::min(minBounds, worldPos);
-                maxBounds = glm::max(maxBounds, worldPos);
-
-                size_t offset = i * 12;
-                vertices[offset + 0] = modelPos.x;
-                vertices[offset + 1] = modelPos.y;
-                vertices[offset + 2] = modelPos.z;
-                vertices[offset + 3] = modelNormal.x;
-                vertices[offset + 4] = modelNormal.y;
-                vertices[offset + 5] = modelNormal.z;
-                vertices[offset + 6] = uv[0];
-                vertices[offset + 7] = uv[1];
-                vertices[offset + 8] = modelTangent.x;
-                vertices[offset + 9] = modelTangent.y;
-                vertices[offset +10] = modelTangent.z;
-                vertices[offset +11] = tangent[3];  // keep handedness as-is
-            }
-
-            std::vector<unsigned int> indices;
-            if (prim->indices) {
-                size_t index_count = prim->indices->count;
-                indices.resize(index_count);
-                for (size_t i = 0; i < index_count; ++i) {
-                    indices[i] = static_cast<unsigned int>(cgltf_accessor_read_index(prim->indices, i));
-                }
-            }
-
-            GLuint vao, vbo, ebo;
-            glGenVertexArrays(1, &vao);
-            glBindVertexArray(vao);
-
-            glGenBuffers(1, &vbo);
-            glBindBuffer(GL_ARRAY_BUFFER, vbo);
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-
-            glGenBuffers(1, &ebo);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-
-            GLsizei stride = 12 * sizeof(float);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-            glEnableVertexAttribArray(1);
-            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
-            glEnableVertexAttribArray(2);
-            glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)(8 * sizeof(float)));
-            glEnableVertexAttribArray(3);
-            glBindVertexArray(0);
-
-            GLuint diffuseTex = 0, specGlossTex = 0, normalTex = 0, occlusionTex = 0, emissiveTex = 0;
-
-            auto loadTex = [&](cgltf_texture_view view) -> GLuint {
+            // only reserve the arena ranges here; decodePrimitives fills them in parallel
+            size_t count = source.position->count;
+            GLint baseVertex = static_cast<GLint>(arenaVertexCount);
+            arenaVertexCount += count;
+            GLuint firstIndex = static_cast<GLuint>(arenaIndexCount);
+            size_t indexCount = source.indices ? source.indices->count : 0;
+            arenaIndexCount += indexCount;
+
+            // textures are decoded after the walk and get their GL names in upload()
+            std::array<int, 5> textureSlot = { -1, -1, -1, -1, -1 };
+            auto loadTex = [&](cgltf_texture_view view) -> int {
                 if (view.texture && view.texture->image && view.texture->image->uri) {
-                    std::string texPath = directory + "/" + view.texture->image->uri;
-                    if (textureCache.count(texPath)) return textureCache[texPath];
-                    GLuint id = loadTextureFromFile(texPath);
-                    textureCache[texPath] = id;
-                    return id;
+                    return addTexture(directory + "/" + view.texture->image->uri);
                 }
-                return 0;
+                return -1;
             };
 
             if (prim->material) {
                 cgltf_material* mat = prim->material;
                 if (mat->has_pbr_specular_glossiness) {
-                    diffuseTex = loadTex(mat->pbr_specular_glossiness.diffuse_texture);
-                    specGlossTex = loadTex(mat->pbr_specular_glossiness.specular_glossiness_texture);
+                    textureSlot[0] = loadTex(mat->pbr_specular_glossiness.diffuse_texture);
+                    textureSlot[1] = loadTex(mat->pbr_specular_glossiness.specular_glossiness_texture);
                 } else if (mat->has_pbr_metallic_roughness) {
-                    diffuseTex = loadTex(mat->pbr_metallic_roughness.base_color_texture);
+                    textureSlot[0] = loadTex(mat->pbr_metallic_roughness.base_color_texture);
                 }
-                normalTex = loadTex(mat->normal_texture);
-                occlusionTex = loadTex(mat->occlusion_texture);
-                emissiveTex = loadTex(mat->emissive_texture);
+                textureSlot[2] = loadTex(mat->normal_texture);
+                textureSlot[3] = loadTex(mat->occlusion_texture);
+                textureSlot[4] = loadTex(mat->emissive_texture);
             }
 
             meshes.push_back(Mesh{
-                    vao, vbo, ebo,
-                    static_cast<GLsizei>(indices.size()),
-                    transform,
-                    diffuseTex, specGlossTex, normalTex, occlusionTex, emissiveTex
+                    0, // arena VAO, filled in once it exists
+                    static_cast<GLsizei>(indexCount),
+                    firstIndex,
+                    GL_UNSIGNED_INT, // narrowed in uploadArena
+                    baseVertex,
+                    static_cast<GLsizei>(count),
+                    0, 0 // instance range, assigned once every node has been visited
+                    // texture IDs come from upload(), bounds from decodePrimitives
             });
+            primitiveMeshes[prim] = meshes.size() - 1;
+            primitiveSources.push_back(source);
+            meshTextureSlots.push_back(textureSlot);
+            meshInstances.push_back({ transform });
         }
     }
 
@@ -203,24 +387,427 @@ void ModelLoader::processNode(cgltf_node* node, const glm::mat4& parentTransform
     }
 }
 
-std::vector<Mesh> ModelLoader::loadModel(const std::string& path) {
+void ModelLoader::decodePrimitives() {
+    PROFILE_ZONE("ModelLoader::decodePrimitives");
+    arenaVertices.resize(arenaVertexCount * 12);  // 3 + 3 + 2 + 4 floats per vertex
+    arenaIndices.resize(arenaIndexCount);
+
+    // Large primitives are split so one huge mesh does not serialize the load. Every vertex chunk
+    // writes the bounds of its own range into its slot; the reduction below runs after the join.
+    constexpr size_t CHUNK_VERTICES = 16384;
+    constexpr size_t CHUNK_INDICES = 65536;
+    struct DecodeTask {
+        size_t mesh;
+        bool indices;        // index range instead of vertex range
+        size_t begin, end;
+        // empty until the task ran; worldMin/worldMax are under the primitive's first instance transform
+        glm::vec3 modelMin = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 modelMax = glm::vec3(std::numeric_limits<float>::lowest());
+        glm::vec3 worldMin = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 worldMax = glm::vec3(std::numeric_limits<float>::lowest());
+    };
+    std::vector<DecodeTask> tasks;
+    for (size_t m = 0; m < meshes.size(); ++m) {
+        size_t vertexCount = size_t(meshes[m].vertexCount);
+        for (size_t begin = 0; begin < vertexCount; begin += CHUNK_VERTICES) {
+            tasks.push_back({ m, false, begin, std::min(vertexCount, begin + CHUNK_VERTICES) });
+        }
+        size_t indexCount = size_t(meshes[m].indexCount);
+        for (size_t begin = 0; begin < indexCount; begin += CHUNK_INDICES) {
+            tasks.push_back({ m, true, begin, std::min(indexCount, begin + CHUNK_INDICES) });
+        }
+    }
+
+    setStage(ModelLoadStage::DecodingGeometry, tasks.size());
+    getLoaderPool().parallelFor(static_cast<int>(tasks.size()), [&](int t) {
+        PROFILE_ZONE("ModelLoader::decodeChunk");
+        DecodeTask& task = tasks[t];
+        const Mesh& mesh = meshes[task.mesh];
+        const PrimitiveSource& source = primitiveSources[task.mesh];
+
+        if (task.indices) {
+            // indices stay relative to the primitive; baseVertex shifts them at draw time
+            GLuint* indices = arenaIndices.data() + mesh.firstIndex;
+            for (size_t i = task.begin; i < task.end; ++i) {
+                indices[i] = static_cast<GLuint>(cgltf_accessor_read_index(source.indices, i));
+            }
+            ++stageDone;
+            return;
+        }
+
+        const glm::mat4& transform = meshInstances[task.mesh].front();
+        float* vertices = arenaVertices.data() + size_t(mesh.baseVertex) * 12;
+        glm::vec3 modelMin(std::numeric_limits<float>::max());
+        glm::vec3 modelMax(std::numeric_limits<float>::lowest());
+        glm::vec3 worldMin(std::numeric_limits<float>::max());
+        glm::vec3 worldMax(std::numeric_limits<float>::lowest());
+
+        for (size_t i = task.begin; i < task.end; ++i) {
+            float pos[3], norm[3] = {0}, uv[2] = {0}, tangent[4] = {0,0,0,1};
+            cgltf_accessor_read_float(source.position, i, pos, 3);
+            if (source.normal) cgltf_accessor_read_float(source.normal, i, norm, 3);
+            if (source.uv) cgltf_accessor_read_float(source.uv, i, uv, 2);
+            if (source.tangent) cgltf_accessor_read_float(source.tangent, i, tangent, 4);
+
+            // Store vertices in model space (let Scene handle all transformations)
+            glm::vec3 modelPos = glm::vec3(pos[0], pos[1], pos[2]);
+            modelMin = glm::min(modelMin, modelPos);
+            modelMax = glm::max(modelMax, modelPos);
+            // Update bounds in world space so normalization accounts for node transforms
+            glm::vec3 worldPos = glm::vec3(transform * glm::vec4(modelPos, 1.0f));
+            worldMin = glm::min(worldMin, worldPos);
+            worldMax = glm::max(worldMax, worldPos);
+
+            float* vertex = vertices + i * 12;
+            vertex[0] = pos[0];
+            vertex[1] = pos[1];
+            vertex[2] = pos[2];
+            vertex[3] = norm[0];
+            vertex[4] = norm[1];
+            vertex[5] = norm[2];
+            vertex[6] = uv[0];
+            vertex[7] = uv[1];
+            vertex[8] = tangent[0];
+            vertex[9] = tangent[1];
+            vertex[10] = tangent[2];
+            vertex[11] = tangent[3];  // keep handedness as-is
+        }
+
+        task.modelMin = modelMin;
+        task.modelMax = modelMax;
+        task.worldMin = worldMin;
+        task.worldMax = worldMax;
+        ++stageDone;
+    });
+
+    // serial reduction in task order, so the result does not depend on scheduling
+    for (const DecodeTask& task : tasks) {
+        if (task.indices) continue;
+        Mesh& mesh = meshes[task.mesh];
+        mesh.boundsMin = glm::min(mesh.boundsMin, task.modelMin);
+        mesh.boundsMax = glm::max(mesh.boundsMax, task.modelMax);
+        minBounds = glm::min(minBounds, task.worldMin);
+        maxBounds = glm::max(maxBounds, task.worldMax);
+    }
+    // further instances only contribute their transformed primitive box
+    for (size_t m = 0; m < meshes.size(); ++m) {
+        for (size_t i = 1; i < meshInstances[m].size(); ++i) {
+            ClusterAABB world = transformAABB(meshes[m].boundsMin, meshes[m].boundsMax, meshInstances[m][i]);
+            minBounds = glm::min(minBounds, world.min);
+            maxBounds = glm::max(maxBounds, world.max);
+        }
+    }
+}
+
+namespace {
+
+struct PackedVertex {
+    uint16_t position[4]; // unorm, [0, 1] across the primitive's bounds; w is padding
+    uint32_t normal;      // snorm 10_10_10_2
+    uint32_t tangent;     // snorm 10_10_10_2, w carries the handedness
+    uint16_t uv[2];       // half float
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must stay tightly packed");
+
+// Maps [0, 1]^3 back onto a primitive's bounds. The scale is the same on every axis so the
+// dequantization folded into the instance matrix leaves normal and tangent directions untouched.
+float getDequantizeScale(const Mesh& mesh) {
+    glm::vec3 extent = mesh.boundsMax - mesh.boundsMin;
+    float maxExtent = std::max({ extent.x, extent.y, extent.z });
+    return maxExtent > 0.0f ? maxExtent : 1.0f;
+}
+
+// Decodes a GL_INT_2_10_10_10_REV attribute with the GL 3.3 signed normalized rule, (2c + 1) / (2^b - 1).
+// GL 4.2 switched to max(c / (2^(b-1) - 1), -1), which is what glm::unpackSnorm3x10_1x2 implements; the
+// two differ by up to half a step, and only the 3.3 one matches the context this renderer creates.
+glm::vec4 decodeSnorm3x10_1x2(uint32_t packed) {
+    auto field = [packed](int shift, int bits) {
+        int32_t c = int32_t(packed << (32 - shift - bits)) >> (32 - bits); // sign-extend
+        return float(2 * c + 1) / float((1 << bits) - 1);
+    };
+    return glm::vec4(field(0, 10), field(10, 10), field(20, 10), field(30, 2));
+}
+
+glm::vec3 safeNormalize(const glm::vec3& v) {
+    float len = glm::length(v);
+    return len > 0.0f ? v / len : v;
+}
+
+// Packs the float vertices of every mesh and measures what the conversion loses, decoding the
+// packed values the way the GPU does.
+std::vector<PackedVertex> quantizeVertices(const std::vector<Mesh>& meshes, const std::vector<float>& vertices) {
+    std::vector<PackedVertex> packed(vertices.size() / 12);
+    float maxPositionError = 0.0f, maxNormalErrorDeg = 0.0f, maxUvError = 0.0f;
+
+    for (const Mesh& mesh : meshes) {
+        // the instance matrix absorbs the dequantization translate(min) * scale(s) (see uploadArena)
+        float scale = getDequantizeScale(mesh);
+        for (GLsizei v = 0; v < mesh.vertexCount; ++v) {
+            size_t index = size_t(mesh.baseVertex) + v;
+            const float* src = vertices.data() + index * 12;
+            glm::vec3 position(src[0], src[1], src[2]);
+            glm::vec3 normal(src[3], src[4], src[5]);
+            glm::vec2 uv(src[6], src[7]);
+            glm::vec3 tangent(src[8], src[9], src[10]);
+            float handedness = src[11] < 0.0f ? -1.0f : 1.0f;
+
+            PackedVertex& out = packed[index];
+            glm::vec3 unit = glm::clamp((position - mesh.boundsMin) / scale, 0.0f, 1.0f);
+            for (int c = 0; c < 3; ++c) out.position[c] = static_cast<uint16_t>(std::lround(unit[c] * 65535.0f));
+            out.position[3] = 0;
+            out.normal = glm::packSnorm3x10_1x2(glm::vec4(safeNormalize(normal), 0.0f));
+            out.tangent = glm::packSnorm3x10_1x2(glm::vec4(safeNormalize(tangent), handedness));
+            out.uv[0] = glm::packHalf1x16(uv.x);
+            out.uv[1] = glm::packHalf1x16(uv.y);
+
+            glm::vec3 decodedPosition = mesh.boundsMin +
+                    glm::vec3(out.position[0], out.position[1], out.position[2]) / 65535.0f * scale;
+            maxPositionError = std::max(maxPositionError, glm::length(decodedPosition - position) /
+                                        std::max(glm::length(mesh.boundsMax - mesh.boundsMin), 1e-20f));
+            if (glm::length(normal) > 0.0f) {
+                glm::vec3 decodedNormal = safeNormalize(glm::vec3(decodeSnorm3x10_1x2(out.normal)));
+                float cosAngle = glm::clamp(glm::dot(decodedNormal, glm::normalize(normal)), -1.0f, 1.0f);
+                maxNormalErrorDeg = std::max(maxNormalErrorDeg, glm::degrees(std::acos(cosAngle)));
+            }
+            glm::vec2 decodedUv(glm::unpackHalf1x16(out.uv[0]), glm::unpackHalf1x16(out.uv[1]));
+            maxUvError = std::max(maxUvError, glm::length(decodedUv - uv));
+        }
+    }
+
+    std::cout << "Quantized " << packed.size() << " vertices to " << sizeof(PackedVertex) << " bytes (was "
+              << 12 * sizeof(float) << "); max error: position " << maxPositionError * 100.0f
+              << "% of primitive size, normal " << maxNormalErrorDeg << " deg, uv " << maxUvError << "\n";
+    return packed;
+}
+
+} // namespace
+
+// Re-packs the 32-bit load-time indices with the narrowest type each primitive allows. Every
+// primitive starts at a multiple of its index size, as glDrawElements offsets require.
+static std::vector<uint8_t> packIndices(std::vector<Mesh>& meshes, const std::vector<GLuint>& indices) {
+    std::vector<uint8_t> packed;
+    packed.reserve(indices.size() * sizeof(GLuint));
+    for (Mesh& mesh : meshes) {
+        bool narrow = mesh.vertexCount <= 65536;
+        size_t indexSize = narrow ? sizeof(uint16_t) : sizeof(uint32_t);
+        packed.resize((packed.size() + indexSize - 1) / indexSize * indexSize);
+
+        size_t byteOffset = packed.size();
+        packed.resize(byteOffset + size_t(mesh.indexCount) * indexSize);
+        for (GLsizei i = 0; i < mesh.indexCount; ++i) {
+            GLuint index = indices[mesh.firstIndex + i];
+            if (narrow) {
+                uint16_t value = static_cast<uint16_t>(index);
+                std::memcpy(packed.data() + byteOffset + i * indexSize, &value, indexSize);
+            } else {
+                std::memcpy(packed.data() + byteOffset + i * indexSize, &index, indexSize);
+            }
+        }
+        mesh.indexType = narrow ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        mesh.firstIndex = static_cast<GLuint>(byteOffset / indexSize);
+    }
+    return packed;
+}
+
+void ModelLoader::optimizeArena(const ModelLoadOptions& options) {
+    // ACMR over the whole model, weighted by triangle count
+    auto modelACMR = [&]() {
+        double misses = 0.0;
+        size_t triangles = 0;
+        for (const Mesh& mesh : meshes) {
+            size_t meshTriangles = size_t(mesh.indexCount) / 3;
+            misses += computeACMR(arenaIndices.data() + mesh.firstIndex, mesh.indexCount, mesh.vertexCount) *
+                      double(meshTriangles);
+            triangles += meshTriangles;
+        }
+        return triangles ? misses / double(triangles) : 0.0;
+    };
+
+    double before = modelACMR();
+    // primitives own disjoint arena ranges, so they are optimized independently
+    setStage(ModelLoadStage::Optimizing, meshes.size());
+    getLoaderPool().parallelFor(static_cast<int>(meshes.size()), [&](int m) {
+        const Mesh& mesh = meshes[m];
+        GLuint* indices = arenaIndices.data() + mesh.firstIndex;
+        float* vertices = arenaVertices.data() + size_t(mesh.baseVertex) * 12;
+        optimizeVertexCache(indices, mesh.indexCount, mesh.vertexCount);
+        if (options.reduceOverdraw) optimizeOverdraw(indices, mesh.indexCount, vertices, mesh.vertexCount, 12);
+        optimizeVertexFetch(vertices, mesh.vertexCount, 12, indices, mesh.indexCount);
+        ++stageDone;
+    });
+    double after = modelACMR();
+
+    std::cout << "Vertex cache ACMR " << before << " -> " << after
+              << (options.reduceOverdraw ? " (with overdraw ordering)" : "") << "\n";
+}
+
+void ModelLoader::packArena(const ModelLoadOptions& options) {
+    PROFILE_ZONE("ModelLoader::packArena");
+    quantized = options.quantizeVertices;
+    if (quantized) {
+        std::vector<PackedVertex> packed = quantizeVertices(meshes, arenaVertices);
+        vertexData.resize(packed.size() * sizeof(PackedVertex));
+        std::memcpy(vertexData.data(), packed.data(), vertexData.size());
+    } else {
+        vertexData.resize(arenaVertices.size() * sizeof(float));
+        std::memcpy(vertexData.data(), arenaVertices.data(), vertexData.size());
+    }
+    indexData = packIndices(meshes, arenaIndices);
+    vertexUpload = vertexData;
+    indexUpload = indexData;
+
+    // quantized positions are decoded by the instance matrix: model * D maps [0, 1]^3 onto the bounds
+    gpuTransforms = instanceTransforms;
+    if (quantized) {
+        for (const Mesh& mesh : meshes) {
+            glm::mat4 dequantize = glm::translate(glm::mat4(1.0f), mesh.boundsMin) *
+                                   glm::scale(glm::mat4(1.0f), glm::vec3(getDequantizeScale(mesh)));
+            for (GLsizei i = 0; i < mesh.instanceCount; ++i) {
+                gpuTransforms[mesh.firstInstance + i] *= dequantize;
+            }
+        }
+    }
+
+    // the packed copies are all that is needed from here on
+    releaseMemory(arenaVertices);
+    releaseMemory(arenaIndices);
+}
+
+// Allocates the arena and uploads the instance buffer; vertex and index data follow in slices.
+void ModelLoader::createArena() {
+    glGenVertexArrays(1, &arena.vao);
+    glBindVertexArray(arena.vao);
+
+    glGenBuffers(1, &arena.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, arena.vbo);
+    arena.vertexBytes = vertexUpload.size();
+    glBufferData(GL_ARRAY_BUFFER, arena.vertexBytes, nullptr, GL_STATIC_DRAW);
+    if (quantized) {
+        arena.vertexStride = sizeof(PackedVertex);
+        GLsizei stride = arena.vertexStride;
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(PackedVertex, position));
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(PackedVertex, normal));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex, uv));
+        glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(PackedVertex, tangent));
+    } else {
+        arena.vertexStride = 12 * sizeof(float);
+        GLsizei stride = arena.vertexStride;
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)(8 * sizeof(float)));
+    }
+    for (GLuint attribute = 0; attribute < 4; ++attribute) glEnableVertexAttribArray(attribute);
+
+    arena.indexBytes = indexUpload.size();
+    glGenBuffers(1, &arena.ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, arena.indexBytes, nullptr, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    arena.instanceBytes = gpuTransforms.size() * sizeof(glm::mat4);
+    glGenBuffers(1, &arena.instanceBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, arena.instanceBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, arena.instanceBytes, gpuTransforms.data(), GL_STATIC_DRAW);
+    glGenTextures(1, &arena.instanceTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, arena.instanceTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, arena.instanceBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    releaseMemory(gpuTransforms);
+}
+
+void ModelLoader::releaseArena(GeometryArena& arena) {
+    if (arena.vao != 0) {
+        glDeleteVertexArrays(1, &arena.vao);
+        glDeleteBuffers(1, &arena.vbo);
+        glDeleteBuffers(1, &arena.ebo);
+        glDeleteTextures(1, &arena.instanceTexture);
+        glDeleteBuffers(1, &arena.instanceBuffer);
+    }
+    arena = {};
+}
+
+bool ModelLoader::supportsTextureCompression() {
+    static const bool supported = [] {
+        bool s3tc = false, s3tcSrgb = false;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+            if (!name) continue;
+            s3tc = s3tc || strcmp(name, "GL_EXT_texture_compression_s3tc") == 0;
+            s3tcSrgb = s3tcSrgb || strcmp(name, "GL_EXT_texture_sRGB") == 0 ||
+                       strcmp(name, "GL_EXT_texture_compression_s3tc_srgb") == 0;
+        }
+        return s3tc && s3tcSrgb;
+    }();
+    return supported;
+}
+
+bool ModelLoader::prepare(const std::string& path, const ModelLoadOptions& loadOptions) {
+    PROFILE_ZONE("ModelLoader::prepare");
+    auto loadStart = std::chrono::steady_clock::now();
+    setStage(ModelLoadStage::Parsing, 0);
+    useTextureCache = loadOptions.useTextureCache;
+    compressTextures = loadOptions.compressTextures;
+    std::string directory = std::filesystem::path(path).parent_path().string();
+
+    // Reset bounds before processing
+    minBounds = glm::vec3(std::numeric_limits<float>::max());
+    maxBounds = glm::vec3(std::numeric_limits<float>::lowest());
+
+    meshes.clear();
+    arena = {};
+    arenaVertexCount = 0;
+    arenaIndexCount = 0;
+    arenaVertices.clear();
+    arenaIndices.clear();
+    instanceTransforms.clear();
+    primitiveMeshes.clear();
+    meshInstances.clear();
+    primitiveSources.clear();
+    textures.clear();
+    textureSlots.clear();
+    meshTextureSlots.clear();
+    vertexUpload = {};
+    indexUpload = {};
+    meshCacheFile.close();
+    texturesUploaded = 0;
+    vertexBytesUploaded = 0;
+    indexBytesUploaded = 0;
+    uploadMs = 0.0;
+    textureUploadMs = 0.0;
+    uploadCalls = 0;
+
+    uint32_t cacheOptions = getMeshCacheOptions(loadOptions);
+    if (loadOptions.useMeshCache && loadFromMeshCache(path, cacheOptions)) {
+        auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+        std::cout << "Loaded " << meshes.size() << " primitives (" << instanceTransforms.size()
+                  << " instances) from the mesh cache in " << ms << " ms; " << vertexUpload.size() / 1024
+                  << " KiB vertex / " << indexUpload.size() / 1024 << " KiB index arena mapped\n";
+        setStage(ModelLoadStage::Uploading, getPendingTextureBytes() + vertexUpload.size() + indexUpload.size());
+        return true;
+    }
+
     cgltf_options options = {};
     cgltf_data* data = nullptr;
-
     if (cgltf_parse_file(&options, path.c_str(), &data) != cgltf_result_success ||
         cgltf_load_buffers(&options, data, path.c_str()) != cgltf_result_success ||
         cgltf_validate(data) != cgltf_result_success) {
         std::cerr << "Failed to load glTF: " << path << "\n";
         if (data) cgltf_free(data);
-        return {};
+        setStage(ModelLoadStage::Failed, 0);
+        return false;
     }
 
-    std::vector<Mesh> meshes;
-    std::string directory = std::filesystem::path(path).parent_path().string();
-
-    // Reset bounds before processing
-    minBounds = glm::vec3(std::numeric_limits<float>::max());
-    maxBounds = glm::vec3(std::numeric_limits<float>::lowest());
+    // external .bin files are part of the cache key; embedded and GLB buffers are covered by the source
+    std::vector<std::string> bufferPaths;
+    for (cgltf_size i = 0; i < data->buffers_count; ++i) {
+        const char* uri = data->buffers[i].uri;
+        if (uri && strncmp(uri, "data:", 5) != 0) bufferPaths.push_back(directory + "/" + uri);
+    }
 
     if (data->scene) {
         for (cgltf_size i = 0; i < data->scene->nodes_count; ++i) {
@@ -230,7 +817,184 @@ std::vector<Mesh> ModelLoader::loadModel(const std::string& path) {
         std::cerr << "No default scene found in glTF file.\n";
     }
 
+    auto textureStart = std::chrono::steady_clock::now();
+    decodeTextures();
+    auto decodeStart = std::chrono::steady_clock::now();
+    decodePrimitives();
+    auto decodeEnd = std::chrono::steady_clock::now();
+    releaseMemory(primitiveSources);
     cgltf_free(data);
 
-    return meshes;
+    // each mesh's instances become one contiguous range
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        meshes[i].firstInstance = static_cast<GLuint>(instanceTransforms.size());
+        meshes[i].instanceCount = static_cast<GLsizei>(meshInstances[i].size());
+        instanceTransforms.insert(instanceTransforms.end(), meshInstances[i].begin(), meshInstances[i].end());
+    }
+    releaseMemory(meshInstances);
+    releaseMemory(primitiveMeshes);
+
+    if (loadOptions.optimizeMeshes) optimizeArena(loadOptions);
+
+    size_t wideIndexBytes = arenaIndices.size() * sizeof(GLuint);
+    packArena(loadOptions);
+    auto loadEnd = std::chrono::steady_clock::now();
+
+    size_t narrowMeshes = 0;
+    for (const Mesh& mesh : meshes) narrowMeshes += mesh.indexType == GL_UNSIGNED_SHORT;
+    std::cout << "Loaded " << meshes.size() << " primitives (" << instanceTransforms.size() << " instances) into a "
+              << vertexData.size() / 1024 << " KiB vertex / " << indexData.size() / 1024 << " KiB index arena; "
+              << narrowMeshes << " primitives use 16-bit indices (32-bit only: " << wideIndexBytes / 1024 << " KiB)\n";
+
+    auto ms = [](auto from, auto to) { return std::chrono::duration<double, std::milli>(to - from).count(); };
+    size_t decodedTextures = 0, cachedTextures = 0;
+    for (const PendingTexture& texture : textures) {
+        decodedTextures += !texture.levels.empty();
+        cachedTextures += texture.id != 0;
+    }
+    std::cout << "Prepared in " << ms(loadStart, loadEnd) << " ms on " << getLoaderPool().getWorkerCount() + 1
+              << " threads: parse " << ms(loadStart, textureStart) << " ms, texture decode "
+              << ms(textureStart, decodeStart) << " ms (" << decodedTextures << " decoded, " << cachedTextures
+              << " already on the GPU), vertex decode " << ms(decodeStart, decodeEnd)
+              << " ms, optimize and pack " << ms(decodeEnd, loadEnd) << " ms\n";
+
+    if (loadOptions.useMeshCache) {
+        auto writeStart = std::chrono::steady_clock::now();
+        if (writeToMeshCache(path, bufferPaths, cacheOptions)) {
+            std::cout << "Wrote mesh cache " << getMeshCachePath(path) << " in "
+                      << ms(writeStart, std::chrono::steady_clock::now()) << " ms\n";
+        }
+    }
+
+    // upload progress is counted in bytes, textures included
+    setStage(ModelLoadStage::Uploading, getPendingTextureBytes() + vertexUpload.size() + indexUpload.size());
+    return true;
+}
+
+uint32_t ModelLoader::getMeshCacheOptions(const ModelLoadOptions& options) {
+    // only the flags that change the packed data; a cache baked with other flags is a miss
+    return (options.quantizeVertices ? 1u : 0u) | (options.optimizeMeshes ? 2u : 0u) |
+           (options.optimizeMeshes && options.reduceOverdraw ? 4u : 0u);
+}
+
+bool ModelLoader::loadFromMeshCache(const std::string& path, uint32_t cacheOptions) {
+    PROFILE_ZONE("ModelLoader::loadFromMeshCache");
+    MeshCacheContents contents;
+    // the stride lets the reader check every draw range against the mapped arena
+    size_t vertexStride = (cacheOptions & 1u) != 0 ? sizeof(PackedVertex) : 12 * sizeof(float);
+    if (!readMeshCache(path, cacheOptions, vertexStride, meshCacheFile, contents)) return false;
+
+    meshes = std::move(contents.meshes);
+    meshTextureSlots = std::move(contents.meshTextureSlots);
+    instanceTransforms = std::move(contents.instanceTransforms);
+    gpuTransforms = std::move(contents.gpuTransforms);
+    minBounds = contents.minBounds;
+    maxBounds = contents.maxBounds;
+    quantized = (cacheOptions & 1u) != 0;
+    // uploaded straight from the mapping
+    vertexUpload = contents.vertexData;
+    indexUpload = contents.indexData;
+
+    // paths were unique when written, so the slots come back in the same order
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    for (const std::string& texturePath : contents.texturePaths) addTexture(directory + "/" + texturePath);
+    decodeTextures();
+    return true;
+}
+
+bool ModelLoader::writeToMeshCache(const std::string& path, const std::vector<std::string>& bufferPaths,
+                                   uint32_t cacheOptions) {
+    PROFILE_ZONE("ModelLoader::writeToMeshCache");
+    MeshCacheContents contents;
+    contents.meshes = meshes;
+    contents.meshTextureSlots = meshTextureSlots;
+    size_t directoryLength = std::filesystem::path(path).parent_path().string().size();
+    for (const PendingTexture& texture : textures) {
+        contents.texturePaths.push_back(texture.path.substr(directoryLength + 1));
+    }
+    contents.instanceTransforms = instanceTransforms;
+    contents.gpuTransforms = gpuTransforms;
+    contents.minBounds = minBounds;
+    contents.maxBounds = maxBounds;
+    contents.vertexData = vertexUpload;
+    contents.indexData = indexUpload;
+    return writeMeshCache(path, bufferPaths, cacheOptions, contents);
+}
+
+size_t ModelLoader::getPendingTextureBytes() const {
+    size_t bytes = 0;
+    for (const PendingTexture& texture : textures) {
+        for (const TextureLevel& level : texture.levels) bytes += level.data.size();
+    }
+    return bytes;
+}
+
+bool ModelLoader::upload(double budgetMs) {
+    if (stage == ModelLoadStage::Done) return true;
+    PROFILE_ZONE("ModelLoader::upload");
+    auto start = std::chrono::steady_clock::now();
+    auto elapsedMs = [&]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    // buffer data goes up in slices so a large arena does not blow the frame budget on its own
+    constexpr size_t SLICE_BYTES = 4 << 20;
+    ++uploadCalls;
+
+    do {
+        if (texturesUploaded < textures.size()) {
+            auto textureStart = std::chrono::steady_clock::now();
+            PendingTexture& texture = textures[texturesUploaded++];
+            for (const TextureLevel& level : texture.levels) stageDone += level.data.size();
+            uploadTexture(texture);
+            textureUploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                         textureStart).count();
+            continue;
+        }
+        if (arena.vao == 0) {
+            createArena();
+            continue;
+        }
+        if (vertexBytesUploaded < vertexUpload.size()) {
+            size_t bytes = std::min(SLICE_BYTES, vertexUpload.size() - vertexBytesUploaded);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, arena.vbo);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, vertexBytesUploaded, bytes, vertexUpload.data() + vertexBytesUploaded);
+            vertexBytesUploaded += bytes;
+            stageDone += bytes;
+            continue;
+        }
+        if (indexBytesUploaded < indexUpload.size()) {
+            size_t bytes = std::min(SLICE_BYTES, indexUpload.size() - indexBytesUploaded);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, arena.ebo);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, indexBytesUploaded, bytes, indexUpload.data() + indexBytesUploaded);
+            indexBytesUploaded += bytes;
+            stageDone += bytes;
+            continue;
+        }
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            Mesh& mesh = meshes[i];
+            mesh.vao = arena.vao;
+            GLuint* ids[5] = { &mesh.diffuseTextureID, &mesh.specularGlossinessTextureID, &mesh.normalTextureID,
+                               &mesh.occlusionTextureID, &mesh.emissiveTextureID };
+            for (int t = 0; t < 5; ++t) {
+                int slot = meshTextureSlots[i][t];
+                *ids[t] = slot >= 0 ? textures[slot].id : 0;
+            }
+        }
+        vertexUpload = {};
+        indexUpload = {};
+        releaseMemory(vertexData);
+        releaseMemory(indexData);
+        meshCacheFile.close();
+        textures.clear();
+        uploadMs += elapsedMs();
+        std::cout << "Uploaded in " << uploadMs << " ms of GL thread time over " << uploadCalls
+                  << " call(s): textures " << textureUploadMs << " ms, buffers " << uploadMs - textureUploadMs
+                  << " ms\n";
+        setStage(ModelLoadStage::Done, 0);
+        return true;
+    } while (elapsedMs() < budgetMs);
+    uploadMs += elapsedMs();
+    return false;
 }
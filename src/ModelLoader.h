@@ -5,43 +5,203 @@
 
 
 #include <glad/glad.h>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <glm/glm.hpp>
+#include "AssetCache.h"
+#include "TextureBaker.h"
 
 struct cgltf_node;
+struct cgltf_accessor;
+struct cgltf_primitive;
 struct cgltf_data;
 
-// represents a single drawable primitive
+// One vertex buffer and one index buffer holding every primitive of a model behind a single VAO;
+// primitives are ranges inside it, drawn with glDrawElementsBaseVertex.
+struct GeometryArena {
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+    GLuint instanceBuffer = 0;  // one model matrix (four RGBA32F texels) per instance
+    GLuint instanceTexture = 0; // texture buffer view of instanceBuffer for the vertex shaders
+    size_t vertexBytes = 0;
+    size_t indexBytes = 0;
+    size_t instanceBytes = 0;
+    GLsizei vertexStride = 0;
+};
+
+struct ModelLoadOptions {
+    // 20-byte vertices instead of 48: 16-bit positions relative to the primitive's bounds,
+    // 10_10_10_2 normals and tangents, half-float UVs
+    bool quantizeVertices = false;
+    // reorder each primitive's triangles for the post-transform vertex cache and its vertices
+    // in first-use order
+    bool optimizeMeshes = false;
+    // additionally sort triangle clusters front-facing-outward first (needs optimizeMeshes)
+    bool reduceOverdraw = false;
+    // read the interleaved arena from <asset>.meshcache when it matches the source and these
+    // options, and write it after a full load otherwise
+    bool useMeshCache = true;
+    // same for every image's mip chain, in <image>.texcache
+    bool useTextureCache = true;
+    // Block-compress every texture on the CPU (BC1/BC3 color, BC5 normal maps, BC4 masks) and upload
+    // it with glCompressedTexImage2D. Only set this when supportsTextureCompression() is true.
+    bool compressTextures = false;
+};
+
+// represents a single drawable primitive, stored once and drawn at every node that references it
 struct Mesh {
-    GLuint vao;
-    GLuint vbo;
-    GLuint ebo;
+    GLuint vao;            // the model's arena VAO
     GLsizei indexCount;
-    glm::mat4 modelMatrix;
+    GLuint firstIndex;     // offset into the arena index buffer, in indices of indexType
+    GLenum indexType;      // GL_UNSIGNED_SHORT when every index fits, else GL_UNSIGNED_INT
+    GLint baseVertex;      // offset into the arena vertex buffer, in vertices
+    GLsizei vertexCount;
+    GLuint firstInstance;  // range of node transforms in the arena instance buffer
+    GLsizei instanceCount;
 
     GLuint diffuseTextureID = 0;
     GLuint specularGlossinessTextureID = 0;
     GLuint normalTextureID = 0;
     GLuint occlusionTextureID = 0;
     GLuint emissiveTextureID = 0;
+
+    // model-space box of the primitive's vertices
+    glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+    glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
 };
 
+enum class ModelLoadStage { Idle, Parsing, DecodingTextures, DecodingGeometry, Optimizing, Uploading, Done, Failed };
+
+struct ModelLoadProgress {
+    ModelLoadStage stage = ModelLoadStage::Idle;
+    float fraction = 0.0f; // of the current stage
+};
+
+const char* getModelLoadStageName(ModelLoadStage stage);
+
+// A load runs in two phases: prepare() parses, decodes and packs everything on the CPU and never
+// touches GL, so it may run on a worker thread; upload() then creates the GL objects on the thread
+// that owns the context, optionally spread over several calls.
 class ModelLoader {
 public:
-    // load and flatten a glTF file into meshes with baked transforms
-    std::vector<Mesh> loadModel(const std::string& path);
+    // returns false when the file cannot be parsed; safe to call off the GL thread
+    bool prepare(const std::string& path, const ModelLoadOptions& options = {});
+    // Uploads textures and buffer slices until budgetMs has passed, always making some progress;
+    // returns true once everything is on the GPU. GL thread only.
+    bool upload(double budgetMs = std::numeric_limits<double>::infinity());
+    // the finished meshes; valid once upload() returned true
+    std::vector<Mesh> takeMeshes() { return std::move(meshes); }
+    // readable from any thread while a load runs
+    ModelLoadProgress getProgress() const;
+
     glm::vec3 minBounds = glm::vec3(FLT_MAX);
     glm::vec3 maxBounds = glm::vec3(-FLT_MAX);
+    // GL buffers of the last loaded model; the caller owns them and frees them with releaseArena
+    GeometryArena arena;
+    // node transforms of every instance; Mesh::firstInstance/instanceCount index into it
+    std::vector<glm::mat4> instanceTransforms;
+
+    static void releaseArena(GeometryArena& arena);
+    // whether the context takes every format compressTextures produces, sRGB BC1/BC3 included. GL thread only.
+    static bool supportsTextureCompression();
 
 private:
+    // A texture referenced by the model. prepare() fills levels from the texture cache or by decoding
+    // the image and building its mip chain, unless an earlier load already uploaded it.
+    struct PendingTexture {
+        std::string path;
+        bool srgb = false;
+        TextureUsage usage = TextureUsage::Color;
+        TextureFormat format = TextureFormat::RGBA8;
+        std::vector<TextureLevel> levels;         // views into cacheFile or pixels
+        std::unique_ptr<MappedFile> cacheFile;
+        std::vector<uint8_t> pixels;
+        bool cacheHit = false;
+        GLuint id = 0;
+    };
+
+    // fills the arena ranges reserved by processNode on the loader thread pool and reduces the bounds
+    void decodePrimitives();
+    void decodeTextures();
+    void decodeTexture(PendingTexture& texture);
+    // derives each texture's usage from the material slots referencing it
+    void assignTextureUsages();
+    // the process-wide GL texture cache keeps compressed and uncompressed copies apart
+    std::string getTextureKey(const std::string& path) const;
+    void optimizeArena(const ModelLoadOptions& options);
+    // quantizes and narrows the arena into the byte streams upload() copies to the GPU
+    void packArena(const ModelLoadOptions& options);
+    void createArena();
+    GLuint uploadTexture(PendingTexture& texture);
+    size_t getPendingTextureBytes() const;
+    void setStage(ModelLoadStage stage, size_t total);
+    static uint32_t getMeshCacheOptions(const ModelLoadOptions& options);
+    bool loadFromMeshCache(const std::string& path, uint32_t cacheOptions);
+    bool writeToMeshCache(const std::string& path, const std::vector<std::string>& bufferPaths,
+                          uint32_t cacheOptions);
+
     void processNode(cgltf_node* node, const glm::mat4& parentTransform, const std::string& directory,
                      std::vector<Mesh>& meshes, const cgltf_data* data);
+    int addTexture(const std::string& path);
 
-    GLuint loadTextureFromFile(const std::string& path);
     glm::mat4 getNodeTransform(cgltf_node* node);
 
+    // accessors of a primitive, gathered while walking the nodes and decoded afterwards
+    struct PrimitiveSource {
+        const cgltf_accessor* position = nullptr;
+        const cgltf_accessor* normal = nullptr;
+        const cgltf_accessor* uv = nullptr;
+        const cgltf_accessor* tangent = nullptr;
+        const cgltf_accessor* indices = nullptr;
+    };
+
+    std::vector<Mesh> meshes;
+    bool quantized = false;
+    bool useTextureCache = true;
+    bool compressTextures = false;
+
+    // CPU side of the arena: processNode sizes it, decodePrimitives fills it and packArena turns it
+    // into the GPU layout
+    size_t arenaVertexCount = 0;
+    size_t arenaIndexCount = 0;
+    std::vector<float> arenaVertices;
+    std::vector<GLuint> arenaIndices; // 32-bit while loading; narrowed per primitive on upload
+    // a primitive reached again through another node only gains an instance
+    std::unordered_map<const cgltf_primitive*, size_t> primitiveMeshes;
+    std::vector<std::vector<glm::mat4>> meshInstances;
+    std::vector<PrimitiveSource> primitiveSources; // parallel to the meshes being built
+
+    std::vector<PendingTexture> textures;
+    std::unordered_map<std::string, int> textureSlots;
+    // per mesh: diffuse, specular-glossiness, normal, occlusion, emissive slot in textures, or -1
+    std::vector<std::array<int, 5>> meshTextureSlots;
+
+    // packed GPU data, kept until upload() has copied it; the upload spans view either these
+    // vectors or the mapped mesh cache
+    std::vector<uint8_t> vertexData;
+    std::vector<uint8_t> indexData;
+    std::span<const uint8_t> vertexUpload;
+    std::span<const uint8_t> indexUpload;
+    MappedFile meshCacheFile;
+    std::vector<glm::mat4> gpuTransforms;
+
+    // upload() resumes where the previous call stopped
+    size_t texturesUploaded = 0;
+    size_t vertexBytesUploaded = 0;
+    size_t indexBytesUploaded = 0;
+    double uploadMs = 0.0;
+    double textureUploadMs = 0.0;  // part of uploadMs
+    int uploadCalls = 0;
 
+    std::atomic<ModelLoadStage> stage{ModelLoadStage::Idle};
+    std::atomic<size_t> stageDone{0};
+    std::atomic<size_t> stageTotal{0};
 };
 
 #endif // DEFERREDRENDERER_MODELLOADER_H
@@ -0,0 +1,99 @@
+#include "PassTimer.h"
+
+const char* getRenderPassName(RenderPass pass) {
+    switch (pass) {
+        case RenderPass::DepthPrepass: return "depth_prepass";
+        case RenderPass::Geometry: return "geometry";
+        case RenderPass::ClusterUpload: return "cluster_upload";
+        case RenderPass::Lighting: return "lighting";
+        default: return "unknown";
+    }
+}
+
+PassTimer::PassTimer() {
+    for (FrameSlot& slot : slots) {
+        glGenQueries(RENDER_PASS_COUNT, slot.queries.data());
+    }
+}
+
+PassTimer::~PassTimer() {
+    for (FrameSlot& slot : slots) {
+        glDeleteQueries(RENDER_PASS_COUNT, slot.queries.data());
+    }
+}
+
+bool PassTimer::collect(FrameSlot& slot, bool wait) {
+    if (!wait) {
+        // queries of one frame finish in submission order, so the last one decides for the whole slot
+        for (int pass = RENDER_PASS_COUNT - 1; pass >= 0; --pass) {
+            if (!slot.used[pass]) continue;
+            GLint available = 0;
+            glGetQueryObjectiv(slot.queries[pass], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) return false;
+            break;
+        }
+    }
+
+    for (int pass = 0; pass < RENDER_PASS_COUNT; ++pass) {
+        if (!slot.used[pass]) continue;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(slot.queries[pass], GL_QUERY_RESULT, &elapsed);
+        slot.timing.gpuMs[pass] = static_cast<double>(elapsed) / 1.0e6;
+    }
+    completed.push_back(slot.timing);
+    slot.pending = false;
+    return true;
+}
+
+void PassTimer::beginFrame() {
+    // hand out whatever finished, oldest first, without waiting on the GPU
+    while (slots[oldest].pending && collect(slots[oldest], false)) {
+        oldest = (oldest + 1) % FRAMES_IN_FLIGHT;
+    }
+
+    current = (current + 1) % FRAMES_IN_FLIGHT;
+    FrameSlot& slot = slots[current];
+    if (slot.pending) {
+        // the GPU is more than FRAMES_IN_FLIGHT frames behind; this is the only place we block
+        collect(slot, true);
+        oldest = (current + 1) % FRAMES_IN_FLIGHT;
+    }
+
+    slot.used.fill(false);
+    slot.timing.frame = frameIndex++;
+    slot.timing.cpuMs.fill(-1.0);
+    slot.timing.gpuMs.fill(-1.0);
+    slot.pending = true;
+}
+
+void PassTimer::begin(RenderPass pass) {
+    if (current < 0) return;
+    FrameSlot& slot = slots[current];
+    int idx = static_cast<int>(pass);
+    slot.used[idx] = true;
+    slot.cpuStart[idx] = std::chrono::steady_clock::now();
+    glBeginQuery(GL_TIME_ELAPSED, slot.queries[idx]);
+}
+
+void PassTimer::end(RenderPass pass) {
+    if (current < 0) return;
+    FrameSlot& slot = slots[current];
+    int idx = static_cast<int>(pass);
+    glEndQuery(GL_TIME_ELAPSED);
+    slot.timing.cpuMs[idx] = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - slot.cpuStart[idx]).count();
+}
+
+std::vector<FrameTiming> PassTimer::takeCompletedFrames() {
+    std::vector<FrameTiming> result;
+    result.swap(completed);
+    return result;
+}
+
+void PassTimer::flush() {
+    for (int i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+        FrameSlot& slot = slots[oldest];
+        if (slot.pending) collect(slot, true);
+        oldest = (oldest + 1) % FRAMES_IN_FLIGHT;
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef CLUSTEREDDEFERREDRENDERER_PASSTIMER_H
+#define CLUSTEREDDEFERREDRENDERER_PASSTIMER_H
+
+#include <glad/glad.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+enum class RenderPass {
+    DepthPrepass,   // only runs when the depth pre-pass is enabled
+    Geometry,
+    ClusterUpload,  // CPU time includes light assignment, GPU time covers the grid/list/light uploads
+    Lighting,
+    Count
+};
+
+const char* getRenderPassName(RenderPass pass);
+
+constexpr int RENDER_PASS_COUNT = static_cast<int>(RenderPass::Count);
+
+// CPU and GPU time of every pass in one frame, in milliseconds; a pass that did not run stays negative
+struct FrameTiming {
+    uint64_t frame = 0;
+    std::array<double, RENDER_PASS_COUNT> cpuMs;
+    std::array<double, RENDER_PASS_COUNT> gpuMs;
+};
+
+// Times render passes on the CPU with a steady clock and on the GPU with GL_TIME_ELAPSED queries.
+// Queries rotate through FRAMES_IN_FLIGHT sets so results are read a few frames late, when they are
+// already available, instead of stalling the pipeline.
+class PassTimer {
+public:
+    PassTimer();
+    ~PassTimer();
+
+    PassTimer(const PassTimer&) = delete;
+    PassTimer& operator=(const PassTimer&) = delete;
+
+    void beginFrame();
+    void begin(RenderPass pass);
+    void end(RenderPass pass);
+
+    // frames whose GPU results have come back since the last call, oldest first
+    std::vector<FrameTiming> takeCompletedFrames();
+
+    // blocks until every outstanding query has a result, e.g. before writing a final report
+    void flush();
+
+    // RAII helper for timing a scope
+    class Scope {
+    public:
+        Scope(PassTimer& timer, RenderPass pass) : timer(timer), pass(pass) { timer.begin(pass); }
+        ~Scope() { timer.end(pass); }
+    private:
+        PassTimer& timer;
+        RenderPass pass;
+    };
+
+private:
+    static constexpr int FRAMES_IN_FLIGHT = 4;
+
+    struct FrameSlot {
+        std::array<GLuint, RENDER_PASS_COUNT> queries{};
+        std::array<bool, RENDER_PASS_COUNT> used{};
+        std::array<std::chrono::steady_clock::time_point, RENDER_PASS_COUNT> cpuStart;
+        FrameTiming timing;
+        bool pending = false;
+    };
+
+    bool collect(FrameSlot& slot, bool wait);
+
+    std::array<FrameSlot, FRAMES_IN_FLIGHT> slots;
+    std::vector<FrameTiming> completed;
+    uint64_t frameIndex = 0;
+    int current = -1;
+    int oldest = 0;
+};
+
+#endif //CLUSTEREDDEFERREDRENDERER_PASSTIMER_H
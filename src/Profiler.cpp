@@ -0,0 +1,191 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct ZoneEvent {
+    const char* name;
+    int64_t start;
+    int64_t end;
+};
+
+// a ring slot; relaxed atomics so the exporter may read a slot while its owner rewrites it
+struct ZoneSlot {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<int64_t> start{0};
+    std::atomic<int64_t> end{0};
+};
+
+// Single-producer ring: only the owning thread writes, and publishes each event by bumping head.
+// The exporter copies a snapshot and, seqlock style, throws away anything the writer may have
+// lapped or been writing meanwhile.
+struct ThreadBuffer {
+    static constexpr uint64_t CAPACITY = 1 << 16;
+
+    std::array<ZoneSlot, CAPACITY> events;
+    std::atomic<uint64_t> head{0};
+    std::atomic<const char*> name{nullptr};
+    uint32_t id = 0;
+    bool retired = false; // owner exited; guarded by registryMutex
+};
+
+constexpr int MAX_FRAMES = 1024;
+
+std::mutex registryMutex;
+// Buffers outlive their threads so late dumps still see their zones, until a new thread takes a
+// retired one over; the registry thus only grows with the number of threads alive at once, not
+// with every pool rebuild or loader thread.
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+uint32_t nextThreadId = 1;
+
+std::array<std::atomic<int64_t>, MAX_FRAMES> frameStarts;
+std::atomic<uint64_t> frameCount{0};
+
+thread_local const char* currentThreadName = nullptr;
+thread_local ThreadBuffer* currentBuffer = nullptr;
+
+// retires the thread's buffer when the thread exits
+struct BufferOwner {
+    ThreadBuffer* buffer = nullptr;
+    ~BufferOwner() {
+        if (!buffer) return;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer->retired = true;
+    }
+};
+thread_local BufferOwner bufferOwner;
+
+// taken on the thread's first recorded zone, so idle or unprofiled threads cost no memory
+ThreadBuffer& localBuffer() {
+    if (!currentBuffer) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        auto retired = std::find_if(registry.begin(), registry.end(),
+                                    [](const std::unique_ptr<ThreadBuffer>& buffer) { return buffer->retired; });
+        if (retired != registry.end()) {
+            // its owner is gone and the exporter reads under the lock, so nothing sees the reset
+            currentBuffer = retired->get();
+            currentBuffer->retired = false;
+            currentBuffer->head.store(0, std::memory_order_relaxed);
+        } else {
+            registry.push_back(std::make_unique<ThreadBuffer>());
+            currentBuffer = registry.back().get();
+        }
+        currentBuffer->id = nextThreadId++; // a new track in the trace, not the dead thread's
+        currentBuffer->name.store(currentThreadName, std::memory_order_relaxed);
+        bufferOwner.buffer = currentBuffer;
+    }
+    return *currentBuffer;
+}
+
+void writeJsonString(std::ostream& out, const char* str) {
+    out << '"';
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\') out << '\\';
+        if (static_cast<unsigned char>(*str) >= 0x20) out << *str;
+    }
+    out << '"';
+}
+
+} // namespace
+
+int64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::setThreadName(const char* name) {
+    currentThreadName = name;
+    if (currentBuffer) currentBuffer->name.store(name, std::memory_order_relaxed);
+}
+
+void Profiler::record(const char* name, int64_t start, int64_t end) {
+    ThreadBuffer& buffer = localBuffer();
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    // orders the previous head bump before these stores: an exporter that sees any of them also
+    // sees head, so its lapped check covers the slot being written
+    std::atomic_thread_fence(std::memory_order_release);
+    ZoneSlot& slot = buffer.events[head % ThreadBuffer::CAPACITY];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::markFrame() {
+    if (!isEnabled()) return;
+    uint64_t frame = frameCount.load(std::memory_order_relaxed);
+    frameStarts[frame % MAX_FRAMES].store(now(), std::memory_order_relaxed);
+    frameCount.store(frame + 1, std::memory_order_release);
+}
+
+bool Profiler::writeChromeTrace(const std::string& path, int frames) {
+    uint64_t recordedFrames = frameCount.load(std::memory_order_acquire);
+    frames = std::clamp<int>(frames, 1, MAX_FRAMES - 1);
+    int64_t since = 0;
+    if (recordedFrames > static_cast<uint64_t>(frames)) {
+        since = frameStarts[(recordedFrames - frames) % MAX_FRAMES].load(std::memory_order_relaxed);
+    }
+
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to write trace: " << path << "\n";
+        return false;
+    }
+
+    out << std::fixed << std::setprecision(3); // microsecond timestamps keep ns resolution
+    std::vector<ZoneEvent> snapshot;
+    bool first = true;
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& buffer : registry) {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t begin = head > ThreadBuffer::CAPACITY ? head - ThreadBuffer::CAPACITY : 0;
+        snapshot.clear();
+        for (uint64_t i = begin; i < head; ++i) {
+            const ZoneSlot& slot = buffer->events[i % ThreadBuffer::CAPACITY];
+            snapshot.push_back({ slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed),
+                                 slot.end.load(std::memory_order_relaxed) });
+        }
+        // Entries the writer overwrote while we copied are no longer trustworthy. The writer may
+        // also be storing event headAfter right now, into the slot of event headAfter - CAPACITY.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t headAfter = buffer->head.load(std::memory_order_relaxed);
+        size_t lapped = headAfter + 1 > begin + ThreadBuffer::CAPACITY
+                                ? headAfter + 1 - begin - ThreadBuffer::CAPACITY
+                                : 0;
+
+        bool namedThread = false;
+        for (size_t i = std::min(lapped, snapshot.size()); i < snapshot.size(); ++i) {
+            const ZoneEvent& event = snapshot[i];
+            if (event.start < since) continue;
+            if (!namedThread) {
+                // threads with nothing in the window are left out entirely
+                const char* threadName = buffer->name.load(std::memory_order_relaxed);
+                if (!first) out << ",\n";
+                first = false;
+                out << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": " << buffer->id
+                    << ", \"args\": {\"name\": ";
+                writeJsonString(out, threadName ? threadName : "thread");
+                out << "}}";
+                namedThread = true;
+            }
+            out << ",\n{\"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->id << ", \"name\": ";
+            writeJsonString(out, event.name);
+            out << ", \"ts\": " << double(event.start) / 1000.0
+                << ", \"dur\": " << double(event.end - event.start) / 1000.0 << "}";
+        }
+    }
+    out << "\n]}\n";
+
+    std::cout << "Trace of the last " << frames << " frames written to " << path << "\n";
+    return static_cast<bool>(out);
+}
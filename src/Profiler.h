@@ -0,0 +1,51 @@
+#ifndef CLUSTEREDDEFERREDRENDERER_PROFILER_H
+#define CLUSTEREDDEFERREDRENDERER_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped CPU zones recorded into per-thread ring buffers and dumped as Chrome trace JSON
+// (chrome://tracing or ui.perfetto.dev). Zone names must be string literals or otherwise outlive
+// the profiler. While disabled a zone costs one relaxed atomic load.
+class Profiler {
+public:
+    static void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // names the calling thread in the trace
+    static void setThreadName(const char* name);
+
+    // call once per frame on the main thread; frames delimit what writeChromeTrace exports
+    static void markFrame();
+
+    // writes every zone recorded during the last frameCount frames
+    static bool writeChromeTrace(const std::string& path, int frameCount);
+
+    static int64_t now();
+    static void record(const char* name, int64_t start, int64_t end);
+
+private:
+    static inline std::atomic<bool> enabled{false};
+};
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) : name(name), start(Profiler::isEnabled() ? Profiler::now() : -1) {}
+    ~ProfileZone() {
+        if (start >= 0) Profiler::record(name, start, Profiler::now());
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    int64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+
+#endif //CLUSTEREDDEFERREDRENDERER_PROFILER_H
@@ -4,14 +4,84 @@
 
 #include <glad/glad.h>
 #include "Scene.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <random>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/color_space.hpp>
+#include <iostream>
 
+namespace {
 
-void Scene::loadModel(const std::string& path) {
-    meshes.clear();
+// drops the options this context cannot honor; called on the GL thread, before prepare() may leave it
+ModelLoadOptions getSupportedLoadOptions(const ModelLoadOptions& options) {
+    ModelLoadOptions supported = options;
+    if (supported.compressTextures && !ModelLoader::supportsTextureCompression()) {
+        std::cerr << "S3TC texture compression is not supported; loading textures uncompressed\n";
+        supported.compressTextures = false;
+    }
+    return supported;
+}
+
+} // namespace
+
+Scene::~Scene() {
+    ModelLoader::releaseArena(geometry);
+    if (pendingLoader) {
+        // the worker only touches CPU data; any buffers it already got on the GPU are ours to free
+        if (pendingPrepare.valid()) pendingPrepare.wait();
+        ModelLoader::releaseArena(pendingLoader->arena);
+    }
+}
+
+void Scene::loadModel(const std::string& path, const ModelLoadOptions& options) {
+    PROFILE_ZONE("Scene::loadModel");
     ModelLoader loader;
-    meshes = loader.loadModel(path);
+    if (!loader.prepare(path, getSupportedLoadOptions(options))) return; // keep showing the current model
+    loader.upload();
+    ModelLoader::releaseArena(geometry);
+    adoptModel(loader);
+}
+
+bool Scene::beginLoadModel(const std::string& path, const ModelLoadOptions& options) {
+    if (pendingLoader) return false;
+    pendingLoader = std::make_unique<ModelLoader>();
+    pendingPrepare = std::async(std::launch::async, [loader = pendingLoader.get(), path,
+                                                     options = getSupportedLoadOptions(options)] {
+        Profiler::setThreadName("loader");
+        return loader->prepare(path, options);
+    });
+    return true;
+}
+
+bool Scene::updateLoading(double uploadBudgetMs) {
+    if (!pendingLoader) return false;
+    if (pendingPrepare.valid()) {
+        if (pendingPrepare.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+        if (!pendingPrepare.get()) {
+            // keep showing the current model
+            pendingLoader.reset();
+            return false;
+        }
+    }
+    if (!pendingLoader->upload(uploadBudgetMs)) return false;
+
+    PROFILE_ZONE("Scene::swapModel");
+    ModelLoader::releaseArena(geometry);
+    adoptModel(*pendingLoader);
+    pendingLoader.reset();
+    return true;
+}
+
+ModelLoadProgress Scene::getLoadProgress() const {
+    return pendingLoader ? pendingLoader->getProgress() : ModelLoadProgress{};
+}
+
+void Scene::adoptModel(ModelLoader& loader) {
+    meshes = loader.takeMeshes();
+    geometry = loader.arena;
     minBounds = loader.minBounds;
     maxBounds = loader.maxBounds;
     glm::vec3 center = 0.5f * (loader.minBounds + loader.maxBounds);
@@ -22,6 +92,19 @@ void Scene::loadModel(const std::string& path) {
     normalization = glm::scale(glm::mat4(1.0f), glm::vec3(scale)) *
                     glm::translate(glm::mat4(1.0f), -center);
 
+    buildDrawOrder();
+
+    // culling works per instance, so every node transform gets its own world-space box
+    const std::vector<glm::mat4>& instances = loader.instanceTransforms;
+    instanceBounds.resize(static_cast<int>(instances.size()));
+    for (const Mesh& mesh : meshes) {
+        for (GLsizei j = 0; j < mesh.instanceCount; ++j) {
+            GLuint instance = mesh.firstInstance + j;
+            ClusterAABB box = transformAABB(mesh.boundsMin, mesh.boundsMax, normalization * instances[instance]);
+            instanceBounds.set(static_cast<int>(instance), box.min, box.max);
+        }
+    }
+
     glm::vec3 basePos = glm::vec3(0.0f, 0.0f, 0.0f);
 
     int numLights = 8;
@@ -48,28 +131,130 @@ void Scene::loadModel(const std::string& path) {
     }
 }
 
-void Scene::drawGeometryPass(const Shader& shader) const {
+// Texture units match the sampler uniforms DeferredRenderer assigns once at program creation:
+// diffuse 0, specular-glossiness 1, normal 2, occlusion 3, emissive 4; instance transforms use 5.
+static std::array<GLuint, 5> getMaterialTextures(const Mesh& mesh) {
+    return { mesh.diffuseTextureID, mesh.specularGlossinessTextureID, mesh.normalTextureID,
+             mesh.occlusionTextureID, mesh.emissiveTextureID };
+}
+
+void Scene::buildDrawOrder() {
+    // every mesh uses the geometry shader, so the key is (texture set, VAO): consecutive draws then
+    // share as many bindings as possible
+    drawOrder.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); ++i) drawOrder[i] = static_cast<uint32_t>(i);
+    std::stable_sort(drawOrder.begin(), drawOrder.end(), [&](uint32_t a, uint32_t b) {
+        auto keyA = std::make_pair(getMaterialTextures(meshes[a]), meshes[a].vao);
+        auto keyB = std::make_pair(getMaterialTextures(meshes[b]), meshes[b].vao);
+        return keyA < keyB;
+    });
+}
+
+// whether any instance of the mesh survived culling, tested a visibility word at a time
+static bool hasVisibleInstance(const Mesh& mesh, const std::vector<uint32_t>& visible) {
+    GLuint end = mesh.firstInstance + mesh.instanceCount;
+    for (GLuint first = mesh.firstInstance; first < end;) {
+        GLuint bit = first % 32;
+        GLuint count = std::min<GLuint>(32 - bit, end - first);
+        uint32_t mask = (count == 32 ? ~0u : (1u << count) - 1) << bit;
+        if (visible[first / 32] & mask) return true;
+        first += count;
+    }
+    return false;
+}
+
+// Issues one instanced draw per run of consecutive visible instances of the mesh. GL 3.3 has no
+// base instance, so the run's first instance reaches the shader through instanceOffset.
+static void drawVisibleInstances(const Mesh& mesh, const std::vector<uint32_t>& visible, const Shader& shader,
+                                 GLint instanceOffsetLoc, DrawStats& stats) {
+    auto isVisible = [&](GLuint i) { return (visible[i / 32] & (1u << (i % 32))) != 0; };
+    GLuint end = mesh.firstInstance + mesh.instanceCount;
+    for (GLuint run = mesh.firstInstance; run < end;) {
+        if (!isVisible(run)) { ++run; continue; }
+        GLuint runEnd = run + 1;
+        while (runEnd < end && isVisible(runEnd)) ++runEnd;
+
+        shader.setInt(instanceOffsetLoc, static_cast<int>(run));
+        size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.indexCount, mesh.indexType,
+                                          (void*)(uintptr_t(mesh.firstIndex) * indexSize),
+                                          static_cast<GLsizei>(runEnd - run), mesh.baseVertex);
+        ++stats.drawCalls;
+        run = runEnd;
+    }
+}
+
+DrawStats Scene::drawGeometryPass(const Shader& shader, const std::vector<uint32_t>& visible) const {
+    PROFILE_ZONE("Scene::drawGeometryPass");
     shader.use();
 
-    for (const Mesh& mesh : meshes) {
-        // Apply both the mesh's local transform and normalization
-        glm::mat4 model = normalization * mesh.modelMatrix;
-        shader.setMat4("model", model);
-
-        glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, mesh.diffuseTextureID);
-        shader.setInt("diffuseTexture", 0);
-        glActiveTexture(GL_TEXTURE1); glBindTexture(GL_TEXTURE_2D, mesh.specularGlossinessTextureID);
-        shader.setInt("specularGlossinessTexture", 1);
-        glActiveTexture(GL_TEXTURE2); glBindTexture(GL_TEXTURE_2D, mesh.normalTextureID);
-        shader.setInt("normalTexture", 2);
-        glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, mesh.occlusionTextureID);
-        shader.setInt("occlusionTexture", 3);
-        glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, mesh.emissiveTextureID);
-        shader.setInt("emissiveTexture", 4);
-
-        glBindVertexArray(mesh.vao);
-        glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
+    // resolved once per pass so the per-mesh loop below does no name lookups
+    const GLint instanceOffsetLoc = shader.getUniformLocation("instanceOffset");
+    shader.setMat4("model", normalization);
+
+    DrawStats stats;
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_BUFFER, geometry.instanceTexture);
+    ++stats.stateChanges;
+
+    // what this pass has bound so far; 0 is a valid texture, so start from an impossible value
+    std::array<GLuint, 5> boundTextures;
+    boundTextures.fill(~0u);
+    GLuint boundVAO = ~0u;
+    int activeUnit = 5;
+
+    for (uint32_t i : drawOrder) {
+        const Mesh& mesh = meshes[i];
+        // a fully culled mesh must not cost binds either
+        if (!hasVisibleInstance(mesh, visible)) continue;
+
+        std::array<GLuint, 5> textures = getMaterialTextures(mesh);
+        for (int unit = 0; unit < 5; ++unit) {
+            if (textures[unit] == boundTextures[unit]) continue;
+            if (unit != activeUnit) {
+                glActiveTexture(GL_TEXTURE0 + unit);
+                activeUnit = unit;
+            }
+            glBindTexture(GL_TEXTURE_2D, textures[unit]);
+            boundTextures[unit] = textures[unit];
+            ++stats.stateChanges;
+        }
+
+        if (mesh.vao != boundVAO) {
+            glBindVertexArray(mesh.vao);
+            boundVAO = mesh.vao;
+            ++stats.stateChanges;
+        }
+        drawVisibleInstances(mesh, visible, shader, instanceOffsetLoc, stats);
     }
+    return stats;
+}
+
+DrawStats Scene::drawDepthPass(const Shader& shader, const std::vector<uint32_t>& visible) const {
+    PROFILE_ZONE("Scene::drawDepthPass");
+    shader.use();
+
+    const GLint instanceOffsetLoc = shader.getUniformLocation("instanceOffset");
+    shader.setMat4("model", normalization);
+
+    DrawStats stats;
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_BUFFER, geometry.instanceTexture);
+    ++stats.stateChanges;
+
+    GLuint boundVAO = ~0u;
+    for (uint32_t i : drawOrder) {
+        const Mesh& mesh = meshes[i];
+        // a fully culled mesh must not cost binds either
+        if (!hasVisibleInstance(mesh, visible)) continue;
+        if (mesh.vao != boundVAO) {
+            glBindVertexArray(mesh.vao);
+            boundVAO = mesh.vao;
+            ++stats.stateChanges;
+        }
+        drawVisibleInstances(mesh, visible, shader, instanceOffsetLoc, stats);
+    }
+    return stats;
 }
 
 const std::vector<Light>& Scene::getLights() const {
@@ -80,7 +265,20 @@ void Scene::addLight(const glm::vec3& position, float radius, const glm::vec3& c
     lights.push_back({position, radius, color, intensity});
 }
 
+void Scene::addRandomLights(int count, float extent) {
+    std::uniform_real_distribution<float> position(-extent, extent);
+    std::uniform_real_distribution<float> radius(0.5f, 3.0f);
+    std::uniform_real_distribution<float> hue(0.0f, 360.0f);
+
+    lights.reserve(lights.size() + count);
+    for (int i = 0; i < count; ++i) {
+        glm::vec3 pos(position(lightRng), position(lightRng), position(lightRng));
+        addLight(pos, radius(lightRng), glm::rgbColor(glm::vec3(hue(lightRng), 0.8f, 1.0f)), 1.0f);
+    }
+}
+
 void Scene::updateLights(float time) {
+    PROFILE_ZONE("Scene::updateLights");
     if (animate) {
         for (size_t i = 0; i < lights.size(); ++i) {
             float angle = time + i;
@@ -9,9 +9,14 @@
 #include "shader.h"
 #include "camera.h"
 #include "ModelLoader.h"
+#include "ClusterCulling.h"
+#include <future>
+#include <memory>
+#include <random>
 #include <vector>
 #include <glm/glm.hpp>
 
+// two vec4s with no padding; uploaded to the lighting shader's light buffer as-is
 struct Light {
     glm::vec3 position;  // world space
     float radius;
@@ -19,12 +24,47 @@ struct Light {
     float intensity;     // light intensity
 };
 
+// what one geometry-pass draw loop issued
+struct DrawStats {
+    unsigned int drawCalls = 0;
+    unsigned int stateChanges = 0; // texture and VAO binds
+
+    DrawStats& operator+=(const DrawStats& other) {
+        drawCalls += other.drawCalls;
+        stateChanges += other.stateChanges;
+        return *this;
+    }
+};
+
 class Scene {
 public:
-    void loadModel(const std::string& path);
-    void drawGeometryPass(const Shader& shader) const;
+    Scene() = default;
+    ~Scene();
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // blocks until the model is on the GPU; a file that fails to load leaves the current model in place
+    void loadModel(const std::string& path, const ModelLoadOptions& options = {});
+    // Prepares the model on a background thread while the current one keeps drawing; returns false
+    // if a load is already in flight.
+    bool beginLoadModel(const std::string& path, const ModelLoadOptions& options = {});
+    // Once per frame on the GL thread: spends up to uploadBudgetMs on the pending load's uploads and
+    // swaps the model in when they are done. Returns true on the frame the new model takes over.
+    bool updateLoading(double uploadBudgetMs);
+    bool isLoading() const { return pendingLoader != nullptr; }
+    ModelLoadProgress getLoadProgress() const;
+    // Draws in material order with instancing; visible holds one bit per instance (see
+    // FrustumAABBsKernel) and instances with a clear bit are skipped.
+    DrawStats drawGeometryPass(const Shader& shader, const std::vector<uint32_t>& visible) const;
+    // positions only, no material state; for the depth pre-pass
+    DrawStats drawDepthPass(const Shader& shader, const std::vector<uint32_t>& visible) const;
+    // per-instance world-space boxes, normalization applied, indexed like the instance buffer
+    const AABBSoA& getInstanceBounds() const { return instanceBounds; }
     const std::vector<Light>& getLights() const;
     void addLight(const glm::vec3& position, float radius, const glm::vec3& color = glm::vec3(1.0f), float intensity = 1.0f);
+    // Scatters small random lights through a box around the origin, for stress testing light counts.
+    // Each scene draws from its own fixed-seed generator, so a scene's light sets are reproducible.
+    void addRandomLights(int count, float extent = 10.0f);
     void updateLights(float time);
     void setAnimate(bool on);
     bool getAnimate();
@@ -33,10 +73,21 @@ public:
     glm::vec3 maxBounds;
 
 private:
+    void adoptModel(ModelLoader& loader);
+    void buildDrawOrder();
+
     std::vector<Mesh> meshes;
+    GeometryArena geometry;          // owned; every mesh draws from it
+    std::vector<uint32_t> drawOrder; // mesh indices sorted by (textures, VAO), rebuilt on load
+    AABBSoA instanceBounds;
     glm::mat4 normalization;
     std::vector<Light> lights;
+    std::mt19937 lightRng{1337}; // addRandomLights
     bool animate = true;
+
+    // in-flight beginLoadModel; the future is declared last so it is joined before the loader dies
+    std::unique_ptr<ModelLoader> pendingLoader;
+    std::future<bool> pendingPrepare;
 };
 
 
@@ -0,0 +1,391 @@
+#include "TextureBaker.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr int LINEAR_TO_SRGB_STEPS = 4096;
+
+float srgbToLinear(float c) {
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+float linearToSrgb(float c) {
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+const std::array<float, 256>& getSrgbDecodeTable() {
+    static const std::array<float, 256> table = [] {
+        std::array<float, 256> values;
+        for (int i = 0; i < 256; ++i) values[i] = srgbToLinear(float(i) / 255.0f);
+        return values;
+    }();
+    return table;
+}
+
+const std::array<uint8_t, LINEAR_TO_SRGB_STEPS + 1>& getSrgbEncodeTable() {
+    static const std::array<uint8_t, LINEAR_TO_SRGB_STEPS + 1> table = [] {
+        std::array<uint8_t, LINEAR_TO_SRGB_STEPS + 1> values;
+        for (int i = 0; i <= LINEAR_TO_SRGB_STEPS; ++i) {
+            float encoded = linearToSrgb(float(i) / LINEAR_TO_SRGB_STEPS);
+            values[i] = static_cast<uint8_t>(std::lround(std::clamp(encoded, 0.0f, 1.0f) * 255.0f));
+        }
+        return values;
+    }();
+    return table;
+}
+
+void downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth,
+                uint32_t dstHeight, bool srgb) {
+    const std::array<float, 256>& decode = getSrgbDecodeTable();
+    const std::array<uint8_t, LINEAR_TO_SRGB_STEPS + 1>& encode = getSrgbEncodeTable();
+
+    for (uint32_t y = 0; y < dstHeight; ++y) {
+        uint32_t y0 = std::min(2 * y, srcHeight - 1);
+        uint32_t y1 = std::min(2 * y + 1, srcHeight - 1);
+        for (uint32_t x = 0; x < dstWidth; ++x) {
+            uint32_t x0 = std::min(2 * x, srcWidth - 1);
+            uint32_t x1 = std::min(2 * x + 1, srcWidth - 1);
+            const uint8_t* texels[4] = {
+                src + (size_t(y0) * srcWidth + x0) * 4, src + (size_t(y0) * srcWidth + x1) * 4,
+                src + (size_t(y1) * srcWidth + x0) * 4, src + (size_t(y1) * srcWidth + x1) * 4,
+            };
+            uint8_t* out = dst + (size_t(y) * dstWidth + x) * 4;
+            for (int c = 0; c < 4; ++c) {
+                // alpha is always linear
+                if (srgb && c < 3) {
+                    float sum = decode[texels[0][c]] + decode[texels[1][c]] + decode[texels[2][c]] +
+                                decode[texels[3][c]];
+                    out[c] = encode[static_cast<int>(sum * 0.25f * LINEAR_TO_SRGB_STEPS + 0.5f)];
+                } else {
+                    int sum = texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c];
+                    out[c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+void buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, std::vector<uint8_t>& storage,
+                   std::vector<TextureLevel>& levels) {
+    // sizes first, so storage is allocated once and the level views stay valid
+    std::vector<std::pair<uint32_t, uint32_t>> sizes;
+    size_t totalBytes = 0;
+    for (uint32_t w = width, h = height;; w = std::max(1u, w / 2), h = std::max(1u, h / 2)) {
+        sizes.emplace_back(w, h);
+        totalBytes += size_t(w) * h * 4;
+        if (w == 1 && h == 1) break;
+    }
+
+    storage.resize(totalBytes);
+    levels.clear();
+    uint8_t* level = storage.data();
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        auto [w, h] = sizes[i];
+        if (i == 0) {
+            std::memcpy(level, rgba, size_t(w) * h * 4);
+        } else {
+            const TextureLevel& parent = levels.back();
+            downsample(parent.data.data(), parent.width, parent.height, level, w, h, srgb);
+        }
+        levels.push_back({ w, h, std::span<const uint8_t>(level, size_t(w) * h * 4) });
+        level += size_t(w) * h * 4;
+    }
+}
+
+namespace {
+
+// block rows encoded per pool task; a 4096x4096 base level has 1024 of them
+constexpr uint32_t BLOCK_ROWS_PER_TASK = 16;
+
+size_t getBlockBytes(TextureFormat format) {
+    return format == TextureFormat::BC1 || format == TextureFormat::BC4 ? 8 : 16;
+}
+
+uint16_t packRgb565(const float color[3]) {
+    auto quantize = [](float c, int maxValue) {
+        return static_cast<uint16_t>(std::lround(std::clamp(c, 0.0f, 255.0f) * float(maxValue) / 255.0f));
+    };
+    return static_cast<uint16_t>(quantize(color[0], 31) << 11 | quantize(color[1], 63) << 5 | quantize(color[2], 31));
+}
+
+void unpackRgb565(uint16_t packed, int color[3]) {
+    int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// picks the nearest of the four palette entries for every texel; returns the summed squared error
+int selectColorIndices(const uint8_t texels[16][4], uint16_t c0, uint16_t c1, uint8_t indices[16]) {
+    int palette[4][3];
+    unpackRgb565(c0, palette[0]);
+    unpackRgb565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    int error = 0;
+    for (int i = 0; i < 16; ++i) {
+        int best = 0, bestError = INT_MAX;
+        for (int p = 0; p < 4; ++p) {
+            int dr = texels[i][0] - palette[p][0];
+            int dg = texels[i][1] - palette[p][1];
+            int db = texels[i][2] - palette[p][2];
+            int e = dr * dr + dg * dg + db * db;
+            if (e < bestError) {
+                bestError = e;
+                best = p;
+            }
+        }
+        indices[i] = static_cast<uint8_t>(best);
+        error += bestError;
+    }
+    return error;
+}
+
+// least-squares endpoints for fixed indices; false when every texel sits on the same palette entry
+bool fitEndpoints(const uint8_t texels[16][4], const uint8_t indices[16], float e0[3], float e1[3]) {
+    static constexpr float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f }; // towards e1
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+    float ax[3] = {}, bx[3] = {};
+    for (int i = 0; i < 16; ++i) {
+        float b = weights[indices[i]];
+        float a = 1.0f - b;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        for (int c = 0; c < 3; ++c) {
+            ax[c] += a * texels[i][c];
+            bx[c] += b * texels[i][c];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (std::abs(det) < 1e-6f) return false;
+    for (int c = 0; c < 3; ++c) {
+        e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+        e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+    }
+    return true;
+}
+
+// BC1 color block: endpoints on the principal axis of the texels, then one least-squares refinement
+void encodeColorBlock(const uint8_t texels[16][4], uint8_t* out) {
+    float mean[3] = {};
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c) mean[c] += texels[i][c];
+    }
+    for (float& m : mean) m /= 16.0f;
+
+    float cov[6] = {}; // rr rg rb gg gb bb
+    for (int i = 0; i < 16; ++i) {
+        float d[3] = { texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2] };
+        cov[0] += d[0] * d[0];
+        cov[1] += d[0] * d[1];
+        cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1];
+        cov[4] += d[1] * d[2];
+        cov[5] += d[2] * d[2];
+    }
+
+    // power iteration; a flat block keeps the grey axis
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[3] = {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+        };
+        float largest = std::max({ std::abs(next[0]), std::abs(next[1]), std::abs(next[2]) });
+        if (largest < 1e-6f) break;
+        for (int c = 0; c < 3; ++c) axis[c] = next[c] / largest;
+    }
+    float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    for (float& a : axis) a /= length;
+
+    float tMin = FLT_MAX, tMax = -FLT_MAX;
+    for (int i = 0; i < 16; ++i) {
+        float t = (texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] +
+                  (texels[i][2] - mean[2]) * axis[2];
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    float e0[3], e1[3];
+    for (int c = 0; c < 3; ++c) {
+        e0[c] = mean[c] + axis[c] * tMax;
+        e1[c] = mean[c] + axis[c] * tMin;
+    }
+
+    uint16_t c0 = packRgb565(e0), c1 = packRgb565(e1);
+    uint8_t indices[16];
+    int error = selectColorIndices(texels, c0, c1, indices);
+    if (error > 0 && fitEndpoints(texels, indices, e0, e1)) {
+        uint16_t r0 = packRgb565(e0), r1 = packRgb565(e1);
+        uint8_t refined[16];
+        if (selectColorIndices(texels, r0, r1, refined) < error) {
+            c0 = r0;
+            c1 = r1;
+            std::memcpy(indices, refined, sizeof(indices));
+        }
+    }
+
+    // c0 > c1 selects the four-color palette; swapping the endpoints swaps indices 0/1 and 2/3
+    if (c0 < c1) {
+        std::swap(c0, c1);
+        for (uint8_t& index : indices) index ^= 1;
+    }
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i) bits |= uint32_t(indices[i]) << (2 * i);
+    out[0] = static_cast<uint8_t>(c0);
+    out[1] = static_cast<uint8_t>(c0 >> 8);
+    out[2] = static_cast<uint8_t>(c1);
+    out[3] = static_cast<uint8_t>(c1 >> 8);
+    for (int b = 0; b < 4; ++b) out[4 + b] = static_cast<uint8_t>(bits >> (8 * b));
+}
+
+// BC4 block (also the alpha half of BC3): the block's range split into eight steps
+void encodeChannelBlock(const uint8_t values[16], uint8_t* out) {
+    uint8_t lo = *std::min_element(values, values + 16);
+    uint8_t hi = *std::max_element(values, values + 16);
+    out[0] = hi;
+    out[1] = lo;
+
+    uint64_t bits = 0;
+    if (hi > lo) {
+        // with the first endpoint larger, code 0 is hi, code 1 is lo and codes 2..7 step from hi to lo
+        int range = hi - lo;
+        for (int i = 0; i < 16; ++i) {
+            int step = ((hi - values[i]) * 14 + range) / (2 * range);
+            int code = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+            bits |= uint64_t(code) << (3 * i);
+        }
+    }
+    for (int b = 0; b < 6; ++b) out[2 + b] = static_cast<uint8_t>(bits >> (8 * b));
+}
+
+// texels past the right or bottom edge repeat the last column or row
+void fetchBlock(const TextureLevel& level, uint32_t blockX, uint32_t blockY, uint8_t texels[16][4]) {
+    for (uint32_t y = 0; y < 4; ++y) {
+        uint32_t sy = std::min(blockY * 4 + y, level.height - 1);
+        for (uint32_t x = 0; x < 4; ++x) {
+            uint32_t sx = std::min(blockX * 4 + x, level.width - 1);
+            std::memcpy(texels[y * 4 + x], level.data.data() + (size_t(sy) * level.width + sx) * 4, 4);
+        }
+    }
+}
+
+void encodeBlock(TextureFormat format, const uint8_t texels[16][4], uint8_t* out) {
+    uint8_t channel[16];
+    auto gather = [&](int c) {
+        for (int i = 0; i < 16; ++i) channel[i] = texels[i][c];
+    };
+    switch (format) {
+        case TextureFormat::BC1:
+            encodeColorBlock(texels, out);
+            break;
+        case TextureFormat::BC3:
+            gather(3);
+            encodeChannelBlock(channel, out);
+            encodeColorBlock(texels, out + 8);
+            break;
+        case TextureFormat::BC4:
+            gather(0);
+            encodeChannelBlock(channel, out);
+            break;
+        case TextureFormat::BC5:
+            gather(0);
+            encodeChannelBlock(channel, out);
+            gather(1);
+            encodeChannelBlock(channel, out + 8);
+            break;
+        case TextureFormat::RGBA8:
+            break;
+    }
+}
+
+} // namespace
+
+TextureFormat chooseCompressedFormat(const TextureLevel& image, TextureUsage usage, bool srgb) {
+    if (usage == TextureUsage::Normal) return TextureFormat::BC5;
+    if (usage == TextureUsage::Mask) return TextureFormat::BC4;
+
+    // BC4 has no sRGB variant, so only linear grey images collapse to one channel
+    bool opaque = true, grey = !srgb;
+    const uint8_t* texel = image.data.data();
+    for (size_t i = 0; i < size_t(image.width) * image.height; ++i, texel += 4) {
+        opaque = opaque && texel[3] == 255;
+        grey = grey && texel[0] == texel[1] && texel[1] == texel[2];
+    }
+    if (!opaque) return TextureFormat::BC3;
+    return grey ? TextureFormat::BC4 : TextureFormat::BC1;
+}
+
+bool isCompressedFormatFor(TextureFormat format, TextureUsage usage, bool srgb) {
+    switch (usage) {
+        case TextureUsage::Normal: return format == TextureFormat::BC5;
+        case TextureUsage::Mask: return format == TextureFormat::BC4;
+        case TextureUsage::Color:
+            return format == TextureFormat::BC1 || format == TextureFormat::BC3 ||
+                   (format == TextureFormat::BC4 && !srgb);
+    }
+    return false;
+}
+
+size_t getTextureLevelBytes(TextureFormat format, uint32_t width, uint32_t height) {
+    if (format == TextureFormat::RGBA8) return size_t(width) * height * 4;
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * getBlockBytes(format);
+}
+
+void compressMipChain(const std::vector<TextureLevel>& rgbaLevels, TextureFormat format, ThreadPool& pool,
+                      std::vector<uint8_t>& storage, std::vector<TextureLevel>& levels) {
+    std::vector<size_t> offsets;
+    size_t totalBytes = 0;
+    for (const TextureLevel& level : rgbaLevels) {
+        offsets.push_back(totalBytes);
+        totalBytes += getTextureLevelBytes(format, level.width, level.height);
+    }
+    storage.resize(totalBytes);
+    levels.clear();
+    for (size_t i = 0; i < rgbaLevels.size(); ++i) {
+        const TextureLevel& level = rgbaLevels[i];
+        levels.push_back({ level.width, level.height,
+                           std::span<const uint8_t>(storage.data() + offsets[i],
+                                                    getTextureLevelBytes(format, level.width, level.height)) });
+    }
+
+    struct Band {
+        size_t level;
+        uint32_t firstRow;
+        uint32_t rowCount;
+    };
+    std::vector<Band> bands;
+    for (size_t i = 0; i < rgbaLevels.size(); ++i) {
+        uint32_t blockRows = (rgbaLevels[i].height + 3) / 4;
+        for (uint32_t row = 0; row < blockRows; row += BLOCK_ROWS_PER_TASK) {
+            bands.push_back({ i, row, std::min(BLOCK_ROWS_PER_TASK, blockRows - row) });
+        }
+    }
+
+    size_t blockBytes = getBlockBytes(format);
+    pool.parallelFor(static_cast<int>(bands.size()), [&](int b) {
+        const Band& band = bands[b];
+        const TextureLevel& level = rgbaLevels[band.level];
+        uint32_t blockColumns = (level.width + 3) / 4;
+        uint8_t* out = storage.data() + offsets[band.level] + size_t(band.firstRow) * blockColumns * blockBytes;
+        uint8_t texels[16][4];
+        for (uint32_t row = band.firstRow; row < band.firstRow + band.rowCount; ++row) {
+            for (uint32_t column = 0; column < blockColumns; ++column, out += blockBytes) {
+                fetchBlock(level, column, row, texels);
+                encodeBlock(format, texels, out);
+            }
+        }
+    });
+}
@@ -0,0 +1,37 @@
+#ifndef CLUSTEREDDEFERREDRENDERER_TEXTUREBAKER_H
+#define CLUSTEREDDEFERREDRENDERER_TEXTUREBAKER_H
+
+#include "AssetCache.h"
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// what the material samples a texture as, which decides how it may be compressed
+enum class TextureUsage {
+    Color,  // all four channels matter (base color, specular-glossiness, emissive, or mixed use)
+    Normal, // tangent-space normal; only x and y are stored, the shader rebuilds z
+    Mask,   // only the red channel is read (occlusion)
+};
+
+// Builds the full mip chain of an RGBA8 image down to 1x1 with a 2x2 box filter (edge texels are
+// repeated for odd sizes). sRGB images are filtered in linear space, as glGenerateMipmap does for
+// sRGB formats. All levels are stored back to back in storage; levels views into it.
+void buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, std::vector<uint8_t>& storage,
+                   std::vector<TextureLevel>& levels);
+
+// Block format for an RGBA8 image: BC5 for normal maps, BC4 for masks and grey linear images, BC3 when
+// any texel is translucent and BC1 otherwise.
+TextureFormat chooseCompressedFormat(const TextureLevel& image, TextureUsage usage, bool srgb);
+// whether chooseCompressedFormat could have picked format for an image used this way
+bool isCompressedFormatFor(TextureFormat format, TextureUsage usage, bool srgb);
+
+size_t getTextureLevelBytes(TextureFormat format, uint32_t width, uint32_t height);
+
+// Encodes every RGBA8 level into a BC format (BC4 from red, BC5 from red and green). Blocks are
+// independent, so bands of block rows are spread over pool. Same storage/levels contract as
+// buildMipChain.
+void compressMipChain(const std::vector<TextureLevel>& rgbaLevels, TextureFormat format, ThreadPool& pool,
+                      std::vector<uint8_t>& storage, std::vector<TextureLevel>& levels);
+
+#endif //CLUSTEREDDEFERREDRENDERER_TEXTUREBAKER_H
@@ -0,0 +1,37 @@
+#ifndef CLUSTEREDDEFERREDRENDERER_THREADPOOL_H
+#define CLUSTEREDDEFERREDRENDERER_THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads fed from a single FIFO queue
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned workerCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned getWorkerCount() const { return static_cast<unsigned>(workers.size()); }
+
+    // runs fn(i) for every i in [0, count) and returns once all of them finished;
+    // the calling thread executes tasks too, so a pool with zero workers runs serially
+    void parallelFor(int count, const std::function<void(int)>& fn);
+
+private:
+    void workerLoop();
+    bool runOneTask();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    bool stopping = false;
+};
+
+#endif //CLUSTEREDDEFERREDRENDERER_THREADPOOL_H
@@ -0,0 +1,81 @@
+#include "TimingStats.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+TimingSummary summarizeTimings(std::vector<double> samples) {
+    TimingSummary summary;
+    if (samples.empty()) return summary;
+
+    std::sort(samples.begin(), samples.end());
+    // nearest-rank percentile
+    auto percentile = [&](double p) {
+        size_t idx = static_cast<size_t>(std::ceil(p * double(samples.size())));
+        return samples[std::clamp<size_t>(idx, 1, samples.size()) - 1];
+    };
+
+    double sum = 0.0;
+    for (double sample : samples) sum += sample;
+    summary.count = samples.size();
+    summary.avg = sum / double(samples.size());
+    summary.min = samples.front();
+    summary.max = samples.back();
+    summary.p50 = percentile(0.50);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    return summary;
+}
+
+void TimingHistory::add(const FrameTiming& timing) {
+    frames.push_back(timing);
+    while (frames.size() > windowSize) frames.pop_front();
+}
+
+TimingSummary TimingHistory::summarizeCpu(RenderPass pass) const {
+    std::vector<double> samples;
+    samples.reserve(frames.size());
+    for (const FrameTiming& timing : frames) {
+        double ms = timing.cpuMs[static_cast<int>(pass)];
+        if (ms >= 0.0) samples.push_back(ms);
+    }
+    return summarizeTimings(std::move(samples));
+}
+
+TimingSummary TimingHistory::summarizeGpu(RenderPass pass) const {
+    std::vector<double> samples;
+    samples.reserve(frames.size());
+    for (const FrameTiming& timing : frames) {
+        double ms = timing.gpuMs[static_cast<int>(pass)];
+        if (ms >= 0.0) samples.push_back(ms);
+    }
+    return summarizeTimings(std::move(samples));
+}
+
+bool TimingHistory::writeCsv(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to write timings: " << path << "\n";
+        return false;
+    }
+
+    out << "frame";
+    for (int pass = 0; pass < RENDER_PASS_COUNT; ++pass) {
+        const char* name = getRenderPassName(static_cast<RenderPass>(pass));
+        out << "," << name << "_cpu_ms," << name << "_gpu_ms";
+    }
+    out << "\n";
+
+    // passes that did not run are left empty
+    for (const FrameTiming& timing : frames) {
+        out << timing.frame;
+        for (int pass = 0; pass < RENDER_PASS_COUNT; ++pass) {
+            out << ",";
+            if (timing.cpuMs[pass] >= 0.0) out << timing.cpuMs[pass];
+            out << ",";
+            if (timing.gpuMs[pass] >= 0.0) out << timing.gpuMs[pass];
+        }
+        out << "\n";
+    }
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,38 @@
+#ifndef CLUSTEREDDEFERREDRENDERER_TIMINGSTATS_H
+#define CLUSTEREDDEFERREDRENDERER_TIMINGSTATS_H
+
+#include "PassTimer.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+struct TimingSummary {
+    double avg = 0.0, min = 0.0, max = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0;
+    size_t count = 0;
+};
+
+TimingSummary summarizeTimings(std::vector<double> samples);
+
+// keeps the most recent frames of pass timings for the stats overlay and CSV export
+class TimingHistory {
+public:
+    explicit TimingHistory(size_t windowSize = 300) : windowSize(windowSize) {}
+
+    void add(const FrameTiming& timing);
+    void clear() { frames.clear(); }
+
+    // statistics over the window; passes that did not run in a frame are skipped
+    TimingSummary summarizeCpu(RenderPass pass) const;
+    TimingSummary summarizeGpu(RenderPass pass) const;
+
+    size_t size() const { return frames.size(); }
+    const FrameTiming* latest() const { return frames.empty() ? nullptr : &frames.back(); }
+
+    bool writeCsv(const std::string& path) const;
+
+private:
+    size_t windowSize;
+    std::deque<FrameTiming> frames;
+};
+
+#endif //CLUSTEREDDEFERREDRENDERER_TIMINGSTATS_H
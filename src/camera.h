@@ -91,6 +91,16 @@ public:
         updateCameraVectors();
     }
 
+    // places the camera at position facing target, used by scripted camera paths
+    void LookAt(const glm::vec3& position, const glm::vec3& target)
+    {
+        Position = position;
+        glm::vec3 direction = glm::normalize(target - position);
+        Pitch = glm::degrees(asin(glm::clamp(direction.y, -1.0f, 1.0f)));
+        Yaw   = glm::degrees(atan2(direction.z, direction.x));
+        updateCameraVectors();
+    }
+
     void ProcessMouseScroll(float yoffset)
     {
         Zoom -= (float)yoffset;
@@ -1,7 +1,19 @@
 #include "Application.h"
+#include "ClusterCulling.h"
+#include <cstring>
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--bench-culling") == 0) {
+        return runClusterCullingBenchmark();
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--headless") == 0) {
+        BenchmarkOptions options;
+        if (!parseBenchmarkArgs(argc, argv, options)) return 1;
+        Application app;
+        return app.runBenchmark(options);
+    }
 
-int main() {
     Application app;
-    app.run();
+    app.run(argc > 1 && std::strcmp(argv[1], "--profile") == 0);
     return 0;
 }
\ No newline at end of file
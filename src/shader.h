@@ -4,7 +4,10 @@
 #include "glad/glad.h"
 #include "glm/glm.hpp"
 
+#include <algorithm>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -13,6 +16,8 @@ class Shader
 {
 public:
     unsigned int ID;
+    // glUniform* calls issued through any Shader; the application resets it every frame
+    static inline unsigned int uniformCallCount = 0;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
@@ -89,6 +94,7 @@ public:
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        cacheUniformLocations();
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -102,66 +108,157 @@ public:
     { 
         glUseProgram(ID); 
     }
-    // utility uniform functions
+    // uniform locations, resolved once after linking; names the active-uniform walk does not list
+    // (array elements such as "lights[3]", struct members) are asked of GL on first use and cached,
+    // -1 included
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    GLint getUniformLocation(std::string_view name) const
+    {
+        auto it = uniformLocations.find(name);
+        if (it != uniformLocations.end())
+            return it->second;
+        std::string key(name);
+        GLint location = glGetUniformLocation(ID, key.c_str());
+        uniformLocations.emplace(std::move(key), location);
+        return location;
+    }
+    // utility uniform functions; the location overloads skip the name lookup entirely
+    // ------------------------------------------------------------------------
+    void setBool(GLint location, bool value) const
+    {
+        ++uniformCallCount;
+        glUniform1i(location, (int)value);
+    }
+    void setBool(std::string_view name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        setBool(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(GLint location, int value) const
+    {
+        ++uniformCallCount;
+        glUniform1i(location, value);
+    }
+    void setInt(std::string_view name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        setInt(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(GLint location, float value) const
+    {
+        ++uniformCallCount;
+        glUniform1f(location, value);
+    }
+    void setFloat(std::string_view name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        setFloat(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(GLint location, const glm::vec2 &value) const
+    {
+        ++uniformCallCount;
+        glUniform2fv(location, 1, &value[0]);
+    }
+    void setVec2(std::string_view name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec2(getUniformLocation(name), value);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(std::string_view name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        setVec2(getUniformLocation(name), glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(GLint location, const glm::vec3 &value) const
+    {
+        ++uniformCallCount;
+        glUniform3fv(location, 1, &value[0]);
+    }
+    void setVec3(std::string_view name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec3(getUniformLocation(name), value);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(std::string_view name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        setVec3(getUniformLocation(name), glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(GLint location, const glm::vec4 &value) const
+    {
+        ++uniformCallCount;
+        glUniform4fv(location, 1, &value[0]);
+    }
+    void setVec4(std::string_view name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec4(getUniformLocation(name), value);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
+    void setVec4(std::string_view name, float x, float y, float z, float w) const
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        setVec4(getUniformLocation(name), glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(GLint location, const glm::mat2 &mat) const
+    {
+        ++uniformCallCount;
+        glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat2(std::string_view name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat2(getUniformLocation(name), mat);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(GLint location, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        ++uniformCallCount;
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat3(std::string_view name, const glm::mat3 &mat) const
+    {
+        setMat3(getUniformLocation(name), mat);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(GLint location, const glm::mat4 &mat) const
+    {
+        ++uniformCallCount;
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(std::string_view name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(getUniformLocation(name), mat);
     }
 
 private:
+    // transparent hash so lookups by string_view or literal never build a std::string
+    struct StringHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+    };
+    mutable std::unordered_map<std::string, GLint, StringHash, std::equal_to<>> uniformLocations;
+
+    // walks every active uniform of the linked program; members of uniform blocks have no location
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(std::max(maxLength, 1), '\0');
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+            std::string uniformName(name.data(), length);
+            GLint location = glGetUniformLocation(ID, uniformName.c_str());
+            if (location < 0)
+                continue;
+            uniformLocations[uniformName] = location;
+            // arrays are reported as "name[0]"; make the bare name resolve too
+            if (uniformName.size() > 3 && uniformName.ends_with("[0]"))
+                uniformLocations[uniformName.substr(0, uniformName.size() - 3)] = location;
+        }
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)